@@ -1,40 +1,132 @@
-#define _POSIX_C_SOURCE 199309L
+#define _GNU_SOURCE
 #include <stdio.h>      
 #include <stdlib.h>     
 #include <unistd.h>          
 #include <sys/wait.h>   
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <math.h>
 #include <string.h>
+#include <signal.h>
 #include <time.h>
+#include "sum_kernel.h"
 #define READ_END 0
 #define WRITE_END 1
+#define CACHE_LINE 64
+
+/* one partial sum per worker, padded so two workers never write the same cache line */
+typedef struct {
+    _Alignas(CACHE_LINE) double sum;
+} result_slot_t;
+
+/* lives in a MAP_SHARED mapping created before fork, so parent and children see the same memory */
+typedef struct {
+    pthread_barrier_t barrier; // K workers + parent, crossed once every slot is written
+    result_slot_t slots[];
+} shared_results_t;
+
+int sum_with_workers(double *array, long N, int K, double *block_sums, enum sum_mode mode);
+double sum_block_range(const double *array, long N, size_t first, size_t last, double *block_sums);
+double *map_data_file(const char *path, long *N, int populate);
+int write_data_file(const char *path, long N);
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c] [-p K] <N>\n"
+                    "       %s [-c] [-p K] [-P] -f <data file>\n"
+                    "       %s -w <data file> <N>\n", prog, prog, prog);
+    exit(1);
+}
 
 int main(int argcount, char *arglist[]) {
 
-    if (argcount != 2) { // check if there was any more or less than 1 argument passed
-        fprintf(stderr, "Usage: %s <N>\n", arglist[0]);   // give out an error message
-        exit(1); 
+    int num_workers = 0; // 0 = the original two children talking over pipes
+    const char *data_path = NULL; // -f: sum a binary file of doubles instead of rand() data
+    const char *out_path = NULL;  // -w: only write N random doubles to a file and exit
+    int populate = 0;             // -P: prefault the whole file with MAP_POPULATE
+    enum sum_mode mode = SUM_PLAIN; // -c: Neumaier-compensated summation
+    int opt;
+    while ((opt = getopt(argcount, arglist, "p:f:w:Pc")) != -1) {
+        if (opt == 'p') {
+            num_workers = atoi(optarg);
+            if (num_workers <= 0) {
+                fprintf(stderr, "Error: K must be a positive integer.\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (opt == 'f') {
+            data_path = optarg;
+        } else if (opt == 'w') {
+            out_path = optarg;
+        } else if (opt == 'P') {
+            populate = 1;
+        } else if (opt == 'c') {
+            mode = SUM_NEUMAIER;
+        } else {
+            usage(arglist[0]);
+        }
     }
-    
-    int N = atoi(arglist[1]); 
-    if (N <= 0) {
-        fprintf(stderr, "Error: N must be a positive integer.\n"); // ensure its positive value
-        exit(EXIT_FAILURE);
+
+    long N = 0;
+    double *array;
+    int array_is_mapped = data_path != NULL;
+
+    if (array_is_mapped) {
+        if (argcount - optind != 0 || out_path != NULL) {
+            usage(arglist[0]);
+        }
+        array = map_data_file(data_path, &N, populate); // N comes from the file size
+        if (array == NULL) {
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        if (argcount - optind != 1) { // check if there was any more or less than 1 argument passed
+            usage(arglist[0]);   // give out an error message
+        }
+
+        N = atol(arglist[optind]); 
+        if (N <= 0) {
+            fprintf(stderr, "Error: N must be a positive integer.\n"); // ensure its positive value
+            exit(EXIT_FAILURE);
+        }
+
+        if (out_path != NULL) {
+            return write_data_file(out_path, N);
+        }
+
+        array = (double *)malloc(N * sizeof(double)); // allocate memory for array of size N
+        if (array == NULL) {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+
+        srand((unsigned int)time(NULL)); // seed the random function
+
+        for (long i = 0; i < N; i++) {
+            array[i] = (double)rand() / (double)RAND_MAX; // RAND_MAX is always > rand, cannot be 0 aswell
+        }
     }
-    
-    double *array = (double *)malloc(N * sizeof(double)); // allocate memory for array of size N
-    if (array == NULL) {
-        perror("malloc failed");
+
+    sum_kernel_init(mode);
+
+    // per-block partial sums, shared with the children; merging them in block order
+    // gives the same total whatever the number of workers
+    size_t num_blocks = sum_num_blocks(N);
+    double *block_sums = mmap(NULL, num_blocks * sizeof(double), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (block_sums == MAP_FAILED) {
+        perror("mmap of block sums failed");
         exit(EXIT_FAILURE);
     }
-    
-    srand((unsigned int)time(NULL)); // seed the random function
-
-     for (int i = 0; i < N; i++) {
-         array[i] = (double)rand() / (double)RAND_MAX; // RAND_MAX is always > rand, cannot be 0 aswell
-     }
 
+    if (num_workers > 0) { // -p K: K children publishing into shared slots instead of two pipes
+        int status = sum_with_workers(array, N, num_workers, block_sums, mode);
+        munmap(block_sums, num_blocks * sizeof(double));
+        if (array_is_mapped) munmap(array, N * sizeof(double));
+        else free(array);
+        return status;
+    }
 
 
     int pipe_1_fd[2]; // create pipes for each child process
@@ -67,18 +159,14 @@ int main(int argcount, char *arglist[]) {
         close(pipe_2_fd[READ_END]);
         close(pipe_2_fd[WRITE_END]);
 
-        double sum1 = 0.0;
-        int end_index = N / 2; // index at half of the array
-        for (int i = 0; i < end_index; i++) {  // iterate and summate all values
-            sum1 += array[i];
-        }
+        double sum1 = sum_block_range(array, N, 0, num_blocks / 2, block_sums); // first half of the blocks
 
         if (write(pipe_1_fd[WRITE_END], &sum1, sizeof(sum1)) == -1) {
             perror("Child 1 write failed");
         }
 
         close(pipe_1_fd[WRITE_END]); // close write end and free child memory
-        free(array);
+        if (!array_is_mapped) free(array);
         exit(EXIT_SUCCESS);
     }
     
@@ -94,18 +182,14 @@ int main(int argcount, char *arglist[]) {
         close(pipe_1_fd[READ_END]);
         close(pipe_1_fd[WRITE_END]);
 
-        double sum2 = 0.0;
-        int start_index = N / 2;   
-        for (int i = start_index; i < N; i++) {
-            sum2 += array[i];
-        }
+        double sum2 = sum_block_range(array, N, num_blocks / 2, num_blocks, block_sums);
 
         if (write(pipe_2_fd[WRITE_END], &sum2, sizeof(sum2)) == -1) {
             perror("Child 2 write failed");
         }
 
         close(pipe_2_fd[WRITE_END]); //close read end and free child memory
-        free(array);
+        if (!array_is_mapped) free(array);
         exit(EXIT_SUCCESS);
     }
 
@@ -132,7 +216,7 @@ int main(int argcount, char *arglist[]) {
     close(pipe_1_fd[READ_END]); // close read ends 
     close(pipe_2_fd[READ_END]);
 
-    double total_sum = child1_sum + child2_sum; // sum from both child processes
+    double total_sum = sum_merge_blocks(block_sums, num_blocks); // sum from both child processes, in block order
    
     clock_gettime(CLOCK_MONOTONIC, &end_time); // stop timer after all processes and computation ends 
 
@@ -147,6 +231,177 @@ int main(int argcount, char *arglist[]) {
                           (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
 
     printf("Total time elapsed: %f seconds\n", time_elapsed);
-    free(array); //free parent memory
+    printf("Kernel: %s%s\n", sum_kernel_name(), mode == SUM_NEUMAIER ? " (compensated)" : "");
+    munmap(block_sums, num_blocks * sizeof(double));
+    if (array_is_mapped) munmap(array, N * sizeof(double)); // drop the file mapping
+    else free(array); //free parent memory
+    return 0;
+}
+
+int sum_with_workers(double *array, long N, int K, double *block_sums, enum sum_mode mode) {
+    size_t shared_size = sizeof(shared_results_t) + (size_t)K * sizeof(result_slot_t);
+    shared_results_t *shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap of result slots failed");
+        return EXIT_FAILURE;
+    }
+
+    pthread_barrierattr_t battr; // barrier has to be process-shared to work across fork
+    pthread_barrierattr_init(&battr);
+    pthread_barrierattr_setpshared(&battr, PTHREAD_PROCESS_SHARED);
+    if (pthread_barrier_init(&shared->barrier, &battr, K + 1) != 0) {
+        fprintf(stderr, "pthread_barrier_init failed\n");
+        munmap(shared, shared_size);
+        return EXIT_FAILURE;
+    }
+    pthread_barrierattr_destroy(&battr);
+
+    pid_t *pids = malloc(K * sizeof(pid_t));
+    if (pids == NULL) {
+        perror("malloc failed");
+        munmap(shared, shared_size);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time); // start timer before fork proccesses
+
+    for (int w = 0; w < K; w++) {
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            perror("fork failed");
+            // children already started would block on the barrier forever, so take them down first
+            for (int i = 0; i < w; i++) {
+                kill(pids[i], SIGKILL);
+                waitpid(pids[i], NULL, 0);
+            }
+            munmap(shared, shared_size);
+            free(pids);
+            return EXIT_FAILURE;
+        }
+
+        if (pids[w] == 0) { // child w sums the contiguous run of blocks [first, last)
+            size_t num_blocks = sum_num_blocks(N);
+            size_t chunk = num_blocks / K;
+            size_t first = w * chunk;
+            size_t last = (w == K - 1) ? num_blocks : first + chunk; // last worker takes the remainder
+
+            shared->slots[w].sum = sum_block_range(array, N, first, last, block_sums);
+            pthread_barrier_wait(&shared->barrier); // publishes the slot to the parent
+            exit(EXIT_SUCCESS);
+        }
+    }
+
+    pthread_barrier_wait(&shared->barrier); // every slot is written once we get past this
+
+    double total_sum = sum_merge_blocks(block_sums, sum_num_blocks(N)); // same order for every K
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time); // stop timer after all slots are collected
+
+    for (int w = 0; w < K; w++) { // reap children outside the timed region
+        waitpid(pids[w], NULL, 0);
+    }
+
+    for (int w = 0; w < K; w++) {
+        printf("Sum from Child %d: %f\n", w + 1, shared->slots[w].sum);
+    }
+    printf("Total sum (parent): %f\n", total_sum);
+
+    double time_elapsed = (end_time.tv_sec - start_time.tv_sec) + // calculate time in seconds
+                          (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+
+    printf("Total time elapsed: %f seconds (%d workers)\n", time_elapsed, K);
+    printf("Kernel: %s%s\n", sum_kernel_name(), mode == SUM_NEUMAIER ? " (compensated)" : "");
+
+    pthread_barrier_destroy(&shared->barrier);
+    munmap(shared, shared_size);
+    free(pids);
+    return 0;
+}
+
+/* sums blocks [first, last) into block_sums and returns their merged partial sum */
+double sum_block_range(const double *array, long N, size_t first, size_t last, double *block_sums) {
+    if (first >= last) {
+        return 0.0;
+    }
+    size_t start = first * SUM_BLOCK;
+    size_t end = last * SUM_BLOCK < (size_t)N ? last * SUM_BLOCK : (size_t)N;
+    sum_blocks_f64(array + start, end - start, block_sums + first);
+    return sum_merge_blocks(block_sums + first, last - first);
+}
+
+/*
+ * Maps a binary file of native-endian doubles read-only. The mapping is shared,
+ * so forked children read straight from the page cache instead of a private
+ * copy, and a second run over the same file starts without regenerating anything.
+ * By default pages are faulted in lazily with read-ahead hinted as sequential,
+ * which lets files larger than RAM stream through; -P prefaults everything up front.
+ */
+double *map_data_file(const char *path, long *N, int populate) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open data file failed");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat failed");
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size < (off_t)sizeof(double) || st.st_size % sizeof(double) != 0) {
+        fprintf(stderr, "Error: %s does not hold a whole number of doubles.\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    int flags = MAP_SHARED;
+    if (populate) flags |= MAP_POPULATE;
+    double *array = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (array == MAP_FAILED) {
+        perror("mmap of data file failed");
+        return NULL;
+    }
+
+    if (!populate && madvise(array, st.st_size, MADV_SEQUENTIAL) == -1) {
+        perror("madvise failed"); // only a hint, keep going
+    }
+
+    *N = st.st_size / sizeof(double);
+    return array;
+}
+
+int write_data_file(const char *path, long N) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror("fopen failed");
+        return EXIT_FAILURE;
+    }
+
+    srand((unsigned int)time(NULL));
+
+    double block[4096]; // write in blocks so N can exceed available memory
+    long written = 0;
+    while (written < N) {
+        long count = N - written < 4096 ? N - written : 4096;
+        for (long i = 0; i < count; i++) {
+            block[i] = (double)rand() / (double)RAND_MAX;
+        }
+        if (fwrite(block, sizeof(double), count, out) != (size_t)count) {
+            perror("fwrite failed");
+            fclose(out);
+            return EXIT_FAILURE;
+        }
+        written += count;
+    }
+
+    if (fclose(out) != 0) {
+        perror("fclose failed");
+        return EXIT_FAILURE;
+    }
+    printf("Wrote %ld doubles to %s\n", N, path);
     return 0;
 }
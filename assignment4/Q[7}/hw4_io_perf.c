@@ -6,13 +6,27 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include "uring.h"
 
 /* Global variables to match reference style logic */
 int n_bytes = 0;           // buffer size from argv[1]
 int p_threads = 0;         // number of threads from argv[2]
 char *data_buffer;         // main memory buffer
 int file_desc;             // file descriptor for I/O
-int num_requests = 100;    // fixed number of requests
+int num_requests = 100;    // number of requests per list, --requests
+
+/* how a request list is run, --engine */
+#define ENGINE_THREADS 0   // p_threads pthreads, each issuing its share with blocking pread/pwrite
+#define ENGINE_URING 1     // one thread keeping up to queue_depth requests in flight through io_uring
+int engine = ENGINE_THREADS;
+int queue_depth = 32;      // --qd
+int batch = 0;             // completions to wait for per io_uring_enter, --batch (0: queue_depth / 4)
+int use_fixed = 0;         // registered buffer and file, --fixed
+uring_t ring;
+char engine_desc[64];      // for the result lines
 
 /* structure for request data */
 typedef struct {
@@ -24,21 +38,63 @@ request_t *current_list;   // pointer to whichever list we are currently process
 
 void *reader_thread_func(void *arg);
 void *writer_thread_func(void *arg);
+int run_requests(int is_write);
 
 /* helper for time calculation */
 double get_elapsed(struct timeval start, struct timeval end) {
     return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
 }
 
+/* user + system time of the whole process so far, io_uring workers included */
+double get_cpu_time(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return get_elapsed((struct timeval){0, 0}, ru.ru_utime) + get_elapsed((struct timeval){0, 0}, ru.ru_stime);
+}
+
+#define USAGE "Usage: %s [--engine threads|uring] [--qd N] [--batch N] [--fixed] [--requests N]\n" \
+              "          <buffer_size> <num_threads>\n"
+
 int main(int argc, char *argv[])
 {
-    if (argc != 3) {
-        printf("Usage: %s <buffer_size> <num_threads>\n", argv[0]);
+    static struct option long_options[] = {
+        {"engine", required_argument, NULL, 'e'},
+        {"qd", required_argument, NULL, 'q'},           /* io_uring queue depth */
+        {"batch", required_argument, NULL, 'b'},        /* completions reaped per io_uring_enter */
+        {"fixed", no_argument, NULL, 'f'},              /* register the buffer and the file with the ring */
+        {"requests", required_argument, NULL, 'n'},     /* requests per list */
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 'e' && strcmp(optarg, "threads") == 0) engine = ENGINE_THREADS;
+        else if (opt == 'e' && strcmp(optarg, "uring") == 0) engine = ENGINE_URING;
+        else if (opt == 'q') queue_depth = atoi(optarg);
+        else if (opt == 'b') batch = atoi(optarg);
+        else if (opt == 'f') use_fixed = 1;
+        else if (opt == 'n') num_requests = atoi(optarg);
+        else {
+            printf(USAGE, argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 2 || queue_depth <= 0 || batch < 0 || num_requests <= 0) {
+        printf(USAGE, argv[0]);
         return 1;
     }
 
-    n_bytes = atoi(argv[1]);
-    p_threads = atoi(argv[2]);
+    n_bytes = atoi(argv[optind]);
+    p_threads = atoi(argv[optind + 1]);
+    if (p_threads <= 0) {
+        printf(USAGE, argv[0]);
+        return 1;
+    }
+    // requests read into and write from data_buffer at their file offset
+    if ((long)n_bytes < (long)num_requests * 16384) {
+        printf("buffer_size must be at least %ld bytes for %d requests of 16384 bytes\n",
+               (long)num_requests * 16384, num_requests);
+        return 1;
+    }
 
     // @create a file for saving the data
     char *filename = "test_data.bin";
@@ -51,6 +107,25 @@ int main(int argc, char *argv[])
     }
     memset(data_buffer, 'B', n_bytes); // fill with dummy data
 
+    if (engine == ENGINE_URING) {
+        if (batch == 0) batch = queue_depth / 4 > 0 ? queue_depth / 4 : 1;
+        if (batch > queue_depth) batch = queue_depth;
+        if (uring_init(&ring, queue_depth) != 0) {
+            perror("io_uring_setup failed");
+            return 1;
+        }
+        // one registered buffer covering data_buffer, so the kernel pins it once instead of per request
+        struct iovec iov = {data_buffer, n_bytes};
+        if (use_fixed && uring_register_buffers(&ring, &iov, 1) != 0) {
+            perror("io_uring buffer registration failed, using plain buffers and files");
+            use_fixed = 0;
+        }
+        snprintf(engine_desc, sizeof(engine_desc), "io_uring qd %d batch %d%s", queue_depth, batch,
+                 use_fixed ? " fixed" : "");
+    } else {
+        snprintf(engine_desc, sizeof(engine_desc), "%d threads", p_threads);
+    }
+
     // @create two lists of 100 requests in the format of [offset, bytes]
     request_t *list1 = (request_t *)malloc(num_requests * sizeof(request_t));
     request_t *list2 = (request_t *)malloc(num_requests * sizeof(request_t));
@@ -82,11 +157,9 @@ int main(int argc, char *argv[])
     }
     free(slot_used);
 
-    /* shared variables for threading */
-    pthread_t *workers = (pthread_t *)malloc(p_threads * sizeof(pthread_t));
-    int *thread_ids = (int *)malloc(p_threads * sizeof(int));
     struct timeval start, end;
     double elapsed;
+    double cpu;
     double total_mb;
 
 
@@ -99,16 +172,10 @@ int main(int argc, char *argv[])
     // @start timing 
     gettimeofday(&start, NULL);
 
-    //Create writer workers and pass in their portion of list1    
-    for (int i = 0; i < p_threads; i++) {
-        thread_ids[i] = i;
-        pthread_create(&workers[i], NULL, writer_thread_func, &thread_ids[i]);
-    }
-     
-    // Wait for all writers to finish 
-    for (int i = 0; i < p_threads; i++) {
-        pthread_join(workers[i], NULL);
-    }
+    cpu = get_cpu_time();
+
+    //Create writer workers and pass in their portion of list1
+    if (run_requests(1) != 0) { close(file_desc); return 1; }
 
     // @close the file 
     fsync(file_desc); // ensure write to disk
@@ -116,14 +183,15 @@ int main(int argc, char *argv[])
 
     // @end timing 
     gettimeofday(&end, NULL);
+    cpu = get_cpu_time() - cpu;
     elapsed = get_elapsed(start, end);
     
     // calculate size for list 1
-    total_mb = (double)(num_requests * 16384) / (1024 * 1024);
+    total_mb = (double)num_requests * 16384 / (1024 * 1024);
 
     //@Print out the write bandwidth
-    printf("List 1 (Sequential): Write %.2f MB, use %d threads, elapsed time %f s, write bandwidth: %f MB/s \n", 
-            total_mb, p_threads, elapsed, total_mb / elapsed);
+    printf("List 1 (Sequential): Write %.2f MB, use %s, elapsed time %f s, write bandwidth: %f MB/s, cpu %.2f us/request \n",
+            total_mb, engine_desc, elapsed, total_mb / elapsed, cpu * 1e6 / num_requests);
 
 
     // 2. Sequential Read (List 1)
@@ -134,26 +202,22 @@ int main(int argc, char *argv[])
     // @start timing 
     gettimeofday(&start, NULL);
 
-    // Create reader workers and pass in their portion of list1   
-    for (int i = 0; i < p_threads; i++) {
-        pthread_create(&workers[i], NULL, reader_thread_func, &thread_ids[i]);
-    }
-     
-    // Wait for all reader to finish 
-    for (int i = 0; i < p_threads; i++) {
-        pthread_join(workers[i], NULL);
-    }
+    cpu = get_cpu_time();
+
+    // Create reader workers and pass in their portion of list1
+    if (run_requests(0) != 0) { close(file_desc); return 1; }
 
     // @close the file 
     close(file_desc);
 
     // @end timing 
     gettimeofday(&end, NULL);
+    cpu = get_cpu_time() - cpu;
     elapsed = get_elapsed(start, end);
 
     //@Print out the read bandwidth
-    printf("List 1 (Sequential): Read %.2f MB, use %d threads, elapsed time %f s, read bandwidth: %f MB/s \n \n", 
-            total_mb, p_threads, elapsed, total_mb / elapsed);
+    printf("List 1 (Sequential): Read %.2f MB, use %s, elapsed time %f s, read bandwidth: %f MB/s, cpu %.2f us/request \n \n",
+            total_mb, engine_desc, elapsed, total_mb / elapsed, cpu * 1e6 / num_requests);
 
 
     // 3. Random Write (List 2)
@@ -163,49 +227,130 @@ int main(int argc, char *argv[])
     current_list = list2; // switch global pointer to list 2
 
     gettimeofday(&start, NULL);
-    for (int i = 0; i < p_threads; i++) {
-        pthread_create(&workers[i], NULL, writer_thread_func, &thread_ids[i]);
-    }
-    for (int i = 0; i < p_threads; i++) {
-        pthread_join(workers[i], NULL);
-    }
+    cpu = get_cpu_time();
+    if (run_requests(1) != 0) { close(file_desc); return 1; }
     fsync(file_desc);
     close(file_desc);
     gettimeofday(&end, NULL);
-    
+    cpu = get_cpu_time() - cpu;
+
     elapsed = get_elapsed(start, end);
-    total_mb = (double)(num_requests * 128) / (1024 * 1024); // recalc size for list 2
+    total_mb = (double)num_requests * 128 / (1024 * 1024); // recalc size for list 2
 
-    printf("List 2 (Random): Write %.4f MB, use %d threads, elapsed time %f s, write bandwidth: %f MB/s \n", 
-            total_mb, p_threads, elapsed, total_mb / elapsed);
+    printf("List 2 (Random): Write %.4f MB, use %s, elapsed time %f s, write bandwidth: %f MB/s, cpu %.2f us/request \n",
+            total_mb, engine_desc, elapsed, total_mb / elapsed, cpu * 1e6 / num_requests);
 
     // 4. Random Read (List 2)
    
     file_desc = open(filename, O_RDONLY);
     
     gettimeofday(&start, NULL);
-    for (int i = 0; i < p_threads; i++) {
-        pthread_create(&workers[i], NULL, reader_thread_func, &thread_ids[i]);
-    }
-    for (int i = 0; i < p_threads; i++) {
-        pthread_join(workers[i], NULL);
-    }
+    cpu = get_cpu_time();
+    if (run_requests(0) != 0) { close(file_desc); return 1; }
     close(file_desc);
     gettimeofday(&end, NULL);
-    
+    cpu = get_cpu_time() - cpu;
+
     elapsed = get_elapsed(start, end);
 
-    printf("List 2 (Random): Read %.4f MB, use %d threads, elapsed time %f s, read bandwidth: %f MB/s \n", 
-            total_mb, p_threads, elapsed, total_mb / elapsed);
+    printf("List 2 (Random): Read %.4f MB, use %s, elapsed time %f s, read bandwidth: %f MB/s, cpu %.2f us/request \n",
+            total_mb, engine_desc, elapsed, total_mb / elapsed, cpu * 1e6 / num_requests);
 
 
     //free up resources properly 
     free(data_buffer);
     free(list1);
     free(list2);
+    if (engine == ENGINE_URING) uring_exit(&ring);
+
+    return 0;
+}
+
+/*
+ * io_uring engine: keeps up to queue_depth requests of current_list in flight.
+ * Every io_uring_enter submits all requests queued since the last one and
+ * waits for `batch` completions, which are then reaped together.
+ */
+int run_uring(int is_write) {
+    int fixed_file = use_fixed;
+    if (fixed_file && uring_register_files(&ring, &file_desc, 1) != 0) {
+        perror("io_uring file registration failed");
+        fixed_file = 0;
+    }
+
+    int next = 0, done = 0, inflight = 0, errors = 0;
+    while (done < num_requests) {
+        while (next < num_requests && inflight < queue_depth) {
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            if (!sqe) break;
+            long off = current_list[next].offset;
+            if (use_fixed) {
+                sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->buf_index = 0;
+            } else {
+                sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+            }
+            if (fixed_file) sqe->flags = IOSQE_FIXED_FILE;
+            sqe->fd = fixed_file ? 0 : file_desc;
+            sqe->addr = (unsigned long)(data_buffer + off);
+            sqe->len = current_list[next].bytes;
+            sqe->off = off;
+            sqe->user_data = next;
+            next++;
+            inflight++;
+        }
+
+        if (uring_submit_and_wait(&ring, batch < inflight ? batch : inflight) < 0) {
+            perror("io_uring_enter failed");
+            errors++;
+            // what the kernel never took will not complete
+            inflight -= uring_discard_unsubmitted(&ring);
+            break;
+        }
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            if (cqe->res < 0) {
+                errno = -cqe->res;
+                perror(is_write ? "write error" : "read error");
+                errors++;
+            }
+            uring_cqe_seen(&ring);
+            done++;
+            inflight--;
+        }
+    }
+
+    // after a failure, the requests already submitted still write into data_buffer: wait for them
+    while (inflight > 0) {
+        if (uring_peek_cqe(&ring) == NULL && uring_submit_and_wait(&ring, 1) < 0) {
+            perror("io_uring_enter failed");
+            break;
+        }
+        if (uring_peek_cqe(&ring) != NULL) {
+            uring_cqe_seen(&ring);
+            inflight--;
+        }
+    }
+
+    if (fixed_file) uring_unregister_files(&ring);
+    return errors ? -1 : 0;
+}
+
+/* runs current_list against file_desc with the chosen engine; -1 if any request failed */
+int run_requests(int is_write) {
+    if (engine == ENGINE_URING) return run_uring(is_write);
+
+    pthread_t *workers = (pthread_t *)malloc(p_threads * sizeof(pthread_t));
+    int *thread_ids = (int *)malloc(p_threads * sizeof(int));
+    for (int i = 0; i < p_threads; i++) {
+        thread_ids[i] = i;
+        pthread_create(&workers[i], NULL, is_write ? writer_thread_func : reader_thread_func, &thread_ids[i]);
+    }
+    for (int i = 0; i < p_threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
     free(workers);
     free(thread_ids);
-
     return 0;
 }
 
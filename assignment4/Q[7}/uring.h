@@ -0,0 +1,58 @@
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+/*
+ * Minimal io_uring on the raw syscalls, without liburing.
+ *
+ * The submission and completion rings are shared with the kernel through
+ * mmap. We fill SQEs at the SQ tail and publish the new tail with a release
+ * store; the kernel fills CQEs at the CQ tail and we hand them back by
+ * moving the CQ head. One io_uring_enter both submits everything published
+ * and waits for a number of completions. Functions return -1 with errno set
+ * on failure.
+ */
+
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sqe_tail;      // SQEs handed out, published to *sq_tail on submit
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;          // same mapping as sq_ring when the kernel has IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+} uring_t;
+
+int uring_init(uring_t *ring, unsigned entries);
+void uring_exit(uring_t *ring);
+
+/* buffer i of iov can then be used by READ_FIXED/WRITE_FIXED with buf_index i */
+int uring_register_buffers(uring_t *ring, const struct iovec *iov, unsigned n);
+/* fds[i] can then be used as fd i with IOSQE_FIXED_FILE */
+int uring_register_files(uring_t *ring, const int *fds, unsigned n);
+int uring_unregister_files(uring_t *ring);
+
+/* a zeroed SQE to fill in, NULL if the submission ring is full */
+struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+/* submits the SQEs taken since the last call and waits for min_complete completions; returns the number submitted */
+int uring_submit_and_wait(uring_t *ring, unsigned min_complete);
+/* drops the SQEs the kernel has not consumed yet (after a failed submit); returns how many */
+unsigned uring_discard_unsubmitted(uring_t *ring);
+/* the oldest completion not yet seen, NULL if there is none */
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+void uring_cqe_seen(uring_t *ring);
+
+#endif
@@ -1,124 +1,372 @@
-#define _POSIX_C_SOURCE 199309L
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <getopt.h>
 #include <time.h>
+#include <sys/mman.h>
+#include "sum_kernel.h"
+#include "thread_pool.h"
+#include "placement.h"
+#include "ws_sched.h"
 
-#define ARRAY_SIZE 1000000
+#define DEFAULT_ARRAY_SIZE 1000000
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define DEFAULT_CHUNK (16 * SUM_BLOCK) /* work-stealing chunk, in floats */
 
 int num_threads = 0;
-float *data_array; 
-void *thread_func(void *arg); /* the thread function */
+int active_threads = 0; /* workers [0, active_threads) take part in a reduction, the rest sit it out */
+size_t array_size = DEFAULT_ARRAY_SIZE;
+size_t array_bytes; /* size of the mapping behind data_array */
+float *data_array;
+double *block_sums; /* one partial sum per SUM_BLOCK elements, filled by whichever thread owns the block */
+thread_pool_t pool;  /* workers are created once and reused for every reduction */
+topology_t topology;
+enum placement_mode placement = PLACE_NONE;
+worker_stat_t *worker_stats; /* where each worker runs and how much it streamed */
+unsigned int init_seed;
+int use_steal = 0;  /* --steal: hand out fixed chunks through the work-stealing scheduler */
+size_t steal_chunk = DEFAULT_CHUNK;
+ws_sched_t sched;
+
+void sum_job(int my_id, void *arg); /* the job each pool worker runs */
+void pin_job(int my_id, void *arg);
+void init_job(int my_id, void *arg);
+float *alloc_array(size_t n, const char **backing);
+void free_array(void);
+int run_sweep(void);
+void run_reduction(void);
 double get_time_diff(struct timespec start, struct timespec end) {
     return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
 }
 
+static void usage(const char *prog) {
+    printf("Usage: %s [-c] [-r repeats] [-n array_size] [--pin | --numa] [--steal [--chunk floats]] [--sweep] <num_threads>\n", prog);
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc != 2) {
-        printf("Usage: %s <num_threads>\n", argv[0]);
+    enum sum_mode mode = SUM_PLAIN;
+    int repeats = 1;
+    int sweep = 0;
+    static struct option long_options[] = {
+        {"pin", no_argument, NULL, 'p'},   /* pin worker i to the i-th CPU */
+        {"numa", no_argument, NULL, 'N'},  /* spread workers over NUMA nodes */
+        {"sweep", no_argument, NULL, 's'}, /* GB/s against thread count for cache- and DRAM-sized arrays */
+        {"steal", no_argument, NULL, 'w'}, /* work-stealing chunks instead of one static slice per thread */
+        {"chunk", required_argument, NULL, 'k'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "cr:n:", long_options, NULL)) != -1) {
+        if (opt == 'c') mode = SUM_NEUMAIER;  /* -c: Neumaier-compensated summation */
+        else if (opt == 'r') repeats = atoi(optarg); /* -r: number of reductions dispatched to the pool */
+        else if (opt == 'n') array_size = strtoull(optarg, NULL, 10); /* -n: number of floats */
+        else if (opt == 'p') placement = PLACE_PIN;
+        else if (opt == 'N') placement = PLACE_NUMA;
+        else if (opt == 's') sweep = 1;
+        else if (opt == 'w') use_steal = 1;
+        else if (opt == 'k') steal_chunk = strtoull(optarg, NULL, 10);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind != 1 || repeats <= 0 || array_size == 0 || steal_chunk == 0) {
+        usage(argv[0]);
         return 1;
     }
 
-    num_threads = atoi(argv[1]);
+    num_threads = atoi(argv[optind]);
+    if (num_threads <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    active_threads = num_threads;
+    steal_chunk = (steal_chunk + SUM_BLOCK - 1) / SUM_BLOCK * SUM_BLOCK; /* chunks must not split a block */
+    sum_kernel_init(mode);
+    worker_stats = (worker_stat_t *)aligned_alloc(CACHE_LINE, num_threads * sizeof(worker_stat_t));
+    if (worker_stats == NULL) {
+        perror("allocation failed");
+        return 1;
+    }
+    if (topology_load(&topology) != 0) {
+        return 1;
+    }
+
+    /* Create a pool of num_threads workers once; startup is timed on its own */
+    struct timespec start_pool, end_pool;
+    clock_gettime(CLOCK_MONOTONIC, &start_pool);
+    if (pool_start(&pool, num_threads) != 0) {
+        return 1;
+    }
+    pool_run(&pool, pin_job, NULL); // every worker pins itself (no-op without --pin/--numa)
+    clock_gettime(CLOCK_MONOTONIC, &end_pool);
+    printf("Pool startup (%d threads, %s), time = %.5f \n", num_threads, placement_name(placement),
+           get_time_diff(start_pool, end_pool));
+
+    init_seed = time(NULL);
+    if (sweep) {
+        int status = run_sweep();
+        pool_stop(&pool);
+        free(worker_stats);
+        topology_free(&topology);
+        return status;
+    }
 
     /* Initialize an array of random values */
-    data_array = (float *)malloc(ARRAY_SIZE * sizeof(float));
-  
+    const char *backing;
+    size_t num_blocks = sum_num_blocks(array_size);
+    block_sums = (double *)malloc(num_blocks * sizeof(double));
+    data_array = alloc_array(array_size, &backing);
+    if (data_array == NULL || block_sums == NULL) {
+        perror("allocation failed");
+        return 1;
+    }
+    printf("Array: %zu floats (%.1f MB, %s)\n", array_size, array_size * sizeof(float) / 1e6, backing);
+    if (use_steal && ws_init(&sched, array_size, steal_chunk, num_threads) != 0) {
+        return 1;
+    }
 
-    srand(time(NULL));
-    for (int i = 0; i < ARRAY_SIZE; i++) {
-        data_array[i] = (float)rand() / (float)RAND_MAX; // Random float in [0,1] resuing code from last assignment
+    if (placement != PLACE_NONE) {
+        /* first touch from the worker that will sum the slice, so its pages land on that worker's node */
+        pool_run(&pool, init_job, NULL);
+    } else {
+        srand(init_seed);
+        for (size_t i = 0; i < array_size; i++) {
+            data_array[i] = (float)rand() / (float)RAND_MAX; // Random float in [0,1] resuing code from last assignment
+        }
     }
 
-   
+
     double sum_serial = 0.0;
     double time_serial = 0.0;
     struct timespec start_serial, end_serial;
 
     clock_gettime(CLOCK_MONOTONIC, &start_serial); // start timer
-    
-    for (int i = 0; i < ARRAY_SIZE; i++) {
-        sum_serial += data_array[i];
-    }
-    
+
+    sum_blocks_f32(data_array, array_size, block_sums);
+    sum_serial = sum_merge_blocks(block_sums, num_blocks);
+
     clock_gettime(CLOCK_MONOTONIC, &end_serial); //end serial timer
-  
 
-time_serial = (end_serial.tv_sec - start_serial.tv_sec) + 
+
+time_serial = (end_serial.tv_sec - start_serial.tv_sec) +
               (end_serial.tv_nsec - start_serial.tv_nsec) / 1000000000.0;
     printf("Serial Sum = %.2f, time = %.5f \n", sum_serial, time_serial);
 
-    /* Create a pool of num_threads workers and keep them in workers */
-    pthread_t *workers = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
-    int *thread_ids = (int *)malloc(num_threads * sizeof(int)); 
-    
     double time_parallel = 0.0;
     double sum_parallel = 0.0;
+    for (int i = 0; i < num_threads; i++) { /* bandwidth counters cover the timed runs only */
+        worker_stats[i].bytes = 0;
+        worker_stats[i].secs = 0.0;
+    }
     struct timespec start_parallel, end_parallel;
     clock_gettime(CLOCK_MONOTONIC, &start_parallel); // start parallel timer
 
-    for (int i = 0; i < num_threads; i++) {
-        pthread_attr_t attr;
-        pthread_attr_init(&attr);
-    
-        thread_ids[i] = i; 
-        
-       
-        if (pthread_create(&workers[i], &attr, thread_func, &thread_ids[i]) != 0) {  // Pass the address of the ID to the thread
-            perror("Failed to create thread");
-        }
+    for (int r = 0; r < repeats; r++) {
+        run_reduction(); // wakes the parked workers and waits for all of them
+        sum_parallel = sum_merge_blocks(block_sums, num_blocks); // block order, so the result does not depend on num_threads
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_parallel); // end parallel timer
+
+    time_parallel = get_time_diff(start_parallel, end_parallel) / repeats;
+
+    printf("Parallel Sum = %.2f, time = %.5f (average of %d, %.0f reductions/s)\n",
+           sum_parallel, time_parallel, repeats, 1.0 / time_parallel);
+    printf("Kernel: %s%s, serial and parallel sums %s\n", sum_kernel_name(),
+           mode == SUM_NEUMAIER ? " (compensated)" : "",
+           sum_serial == sum_parallel ? "match bit for bit" : "DIFFER");
+    if (placement != PLACE_NONE) {
+        placement_report(&topology, worker_stats, num_threads);
+    }
+    if (use_steal) {
+        ws_report(&sched);
+        ws_free(&sched);
     }
 
-    for (int i = 0; i < num_threads; i++) {
-        void *retval;
-        pthread_join(workers[i], &retval);
-        
-        if (retval != NULL) {
-            sum_parallel += *(double*)retval; // sum results
-            free(retval); // Free the memory inside threads
+    /* free up resources properly */
+    pool_stop(&pool);
+    free_array();
+    free(block_sums);
+    free(worker_stats);
+    topology_free(&topology);
+
+    return 0;
+}
+
+/*
+ * Multi-GB arrays are backed by huge pages so the reduction is not throttled by
+ * TLB misses: explicit 2 MB hugetlb pages if any are reserved, otherwise a
+ * normal mapping marked for transparent huge pages. Small arrays stay on 4K pages.
+ */
+float *alloc_array(size_t n, const char **backing) {
+    size_t bytes = n * sizeof(float);
+    void *p = MAP_FAILED;
+
+    if (bytes >= HUGE_PAGE_SIZE) {
+        array_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        p = mmap(NULL, array_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        *backing = "hugetlb 2M pages";
+        if (p == MAP_FAILED) { /* no reserved hugepages: fall back to THP */
+            p = mmap(NULL, array_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED) {
+                *backing = madvise(p, array_bytes, MADV_HUGEPAGE) == 0 ? "transparent huge pages" : "4K pages";
+            }
         }
+    } else {
+        array_bytes = bytes;
+        p = mmap(NULL, array_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        *backing = "4K pages";
     }
+    return p == MAP_FAILED ? NULL : (float *)p;
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &end_parallel); // end parallel timer
+void free_array(void) {
+    munmap(data_array, array_bytes);
+    data_array = NULL;
+}
 
+/*
+ * Throughput sweep: for arrays sized to sit in L1, L2, L3 and DRAM, run the
+ * reduction on 1, 2, 4, ... active workers and print GB/s. Cache sizes come
+ * from sysconf; each point repeats until about 2 GB has been streamed.
+ */
+int run_sweep(void) {
+    long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l1 <= 0) l1 = 32 * 1024;
+    if (l2 <= 0) l2 = 1024 * 1024;
+    if (l3 <= 0) l3 = 16 * 1024 * 1024;
+    long dram = 4 * l3 > 256L * 1024 * 1024 ? 4 * l3 : 256L * 1024 * 1024;
 
+    const char *levels[] = {"L1", "L2", "L3", "DRAM"};
+    size_t bytes[] = {l1 / 2, l2 / 2, l3 / 2, dram}; /* half a cache leaves room for everything else */
 
-time_parallel = (end_parallel.tv_sec - start_parallel.tv_sec) + 
-              (end_parallel.tv_nsec - start_parallel.tv_nsec) / 1000000000.0;
+    printf("level,bytes,threads,GB/s\n");
+    for (int l = 0; l < 4; l++) {
+        const char *backing;
+        array_size = bytes[l] / sizeof(float);
+        data_array = alloc_array(array_size, &backing);
+        block_sums = (double *)malloc(sum_num_blocks(array_size) * sizeof(double));
+        if (data_array == NULL || block_sums == NULL) {
+            perror("allocation failed");
+            return 1;
+        }
 
+        active_threads = num_threads;
+        pool_run(&pool, init_job, NULL); /* parallel first touch, also warms the caches */
 
-    printf("Parallel Sum = %.2f, time = %.5f \n", sum_parallel, time_parallel);
+        int repeats = (int)(2e9 / (array_size * sizeof(float)));
+        if (repeats < 3) repeats = 3;
 
-    /* free up resources properly */
-    free(data_array);
-    free(workers);
-    free(thread_ids);
+        for (int t = 1; ; t = (t * 2 < num_threads) ? t * 2 : num_threads) {
+            active_threads = t;
+            if (use_steal && ws_init(&sched, array_size, steal_chunk, t) != 0) {
+                return 1;
+            }
+            run_reduction(); /* warm-up */
 
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int r = 0; r < repeats; r++) {
+                run_reduction();
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            if (use_steal) {
+                ws_free(&sched);
+            }
+
+            double secs = get_time_diff(start, end);
+            printf("%s,%zu,%d,%.2f\n", levels[l], array_size * sizeof(float), t,
+                   (double)repeats * array_size * sizeof(float) / secs / 1e9);
+            if (t == num_threads) break;
+        }
+
+        free_array();
+        free(block_sums);
+    }
     return 0;
 }
 
-void *thread_func(void *arg) {
-    /* Assign each thread an id so that they are unique in range [0, num_thread -1 ] */
-    int my_id = *(int*)arg;
+void run_reduction(void) {
+    if (use_steal) {
+        ws_reset(&sched); /* deal the chunks out again, counters keep accumulating */
+    }
+    pool_run(&pool, sum_job, NULL);
+}
+
+/* Calculate bounds for a thread, in whole SUM_BLOCKs so block sums line up across thread counts */
+static void block_range(int my_id, size_t *first_block, size_t *last_block) {
+    size_t num_blocks = sum_num_blocks(array_size);
+    size_t chunk_size = num_blocks / active_threads;
+    *first_block = my_id * chunk_size;
+    *last_block = *first_block + chunk_size;
+
+    /* Handle the remainder for the last thread; workers past active_threads get nothing */
+    if (my_id == active_threads - 1) {
+        *last_block = num_blocks;
+    } else if (my_id >= active_threads) {
+        *first_block = *last_block = 0;
+    }
+}
+
+void pin_job(int my_id, void *arg) {
+    (void)arg;
+    placement_apply(&topology, placement_cpu(&topology, placement, my_id, num_threads), &worker_stats[my_id]);
+}
 
-    /* Calculate bounds for this thread */
-    int chunk_size = ARRAY_SIZE / num_threads;
-    int start_index = my_id * chunk_size;
-    int end_index = start_index + chunk_size;
+void init_job(int my_id, void *arg) {
+    (void)arg;
+    size_t first_block, last_block;
+    block_range(my_id, &first_block, &last_block);
 
-    /* Handle the remainder for the last thread */
-    if (my_id == num_threads - 1) {
-        end_index = ARRAY_SIZE;
+    unsigned int seed = init_seed + my_id; /* rand() is not thread safe, each worker gets its own stream */
+    size_t end_index = last_block * SUM_BLOCK < array_size ? last_block * SUM_BLOCK : array_size;
+    for (size_t i = first_block * SUM_BLOCK; i < end_index; i++) {
+        data_array[i] = (float)rand_r(&seed) / (float)RAND_MAX;
     }
+}
+
+/* work-stealing callback: [begin, end) is a whole number of SUM_BLOCKs except at the array end */
+static void sum_chunk(int worker, size_t begin, size_t end, void *arg) {
+    (void)arg;
+    sum_blocks_f32(data_array + begin, end - begin, block_sums + begin / SUM_BLOCK);
+    worker_stats[worker].bytes += (end - begin) * sizeof(float);
+}
 
-    /* Perform Partial Parallel Sum Here */
-    double *my_sum_ptr = (double *)malloc(sizeof(double)); 
-    *my_sum_ptr = 0.0;
+void sum_job(int my_id, void *arg) {
+    (void)arg;
+    if (use_steal) {
+        if (my_id < active_threads) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            ws_work(&sched, my_id, sum_chunk, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            worker_stats[my_id].secs += get_time_diff(start, end);
+        }
+        return;
+    }
 
-    for (int i = start_index; i < end_index; i++) {
-        *my_sum_ptr += data_array[i];
+    size_t first_block, last_block;
+    block_range(my_id, &first_block, &last_block);
+    if (first_block == last_block) {
+        return;
     }
-    pthread_exit((void*)my_sum_ptr);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* Perform Partial Parallel Sum Here, into this worker's run of block sums */
+    size_t start_index = first_block * SUM_BLOCK;
+    size_t end_index = last_block * SUM_BLOCK < array_size ? last_block * SUM_BLOCK : array_size;
+    sum_blocks_f32(data_array + start_index, end_index - start_index, block_sums + first_block);
+    worker_stats[my_id].bytes += (end_index - start_index) * sizeof(float);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    worker_stats[my_id].secs += get_time_diff(start, end);
 }
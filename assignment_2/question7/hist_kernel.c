@@ -0,0 +1,421 @@
+#include "hist_kernel.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTITIONED_BATCH 65536  // values binned per round of the partitioned strategy
+#define MAX_LUT_CELLS (1 << 22)
+
+/*
+ * Bin functions write counter offsets, (bin << shift) + (i & mask). The
+ * partitioned strategy uses them with shift 0, as plain bin numbers, to fill
+ * its batch. The direct strategy instead bins and counts in the same loop
+ * (count_* below), so bin numbers go from the register straight to the
+ * increment instead of through a batch buffer in memory.
+ */
+typedef void (*bins_fn)(const hist_spec_t *spec, int shift, const double *data, size_t n, int *bins);
+typedef void (*count_fn)(const hist_spec_t *spec, int shift, const double *data, size_t n, int *counts);
+
+static void bins_uniform_scalar(const hist_spec_t *spec, int shift, const double *data, size_t n, int *bins);
+static void count_uniform_scalar(const hist_spec_t *spec, int shift, const double *data, size_t n, int *counts);
+
+static const char *kernel_name = "scalar";
+static bins_fn uniform_bins = bins_uniform_scalar;
+static count_fn uniform_count = count_uniform_scalar;
+
+/* ---------------- bin numbers ---------------- */
+
+/* clamps in floating point before converting, so huge values and NaN cannot overflow the int */
+static inline int uniform_bin(const hist_spec_t *spec, double x) {
+    double v = (x - spec->min) * spec->scale;
+    double hi = spec->nbins - 1;
+    v = v > 0.0 ? v : 0.0; // NaN goes to bin 0, like the vector max below
+    v = v < hi ? v : hi;
+    return (int)v;
+}
+
+static void bins_uniform_scalar(const hist_spec_t *spec, int shift, const double *data, size_t n, int *bins) {
+    int mask = (1 << shift) - 1;
+    for (size_t i = 0; i < n; i++) {
+        bins[i] = (uniform_bin(spec, data[i]) << shift) + (i & mask);
+    }
+}
+
+__attribute__((target("avx2")))
+static void bins_uniform_avx2(const hist_spec_t *spec, int shift, const double *data, size_t n, int *bins) {
+    const __m256d lo = _mm256_set1_pd(spec->min);
+    const __m256d scale = _mm256_set1_pd(spec->scale);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d hi = _mm256_set1_pd(spec->nbins - 1);
+    const __m256i lane = _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32((1 << shift) - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d v0 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(data + i), lo), scale);
+        __m256d v1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(data + i + 4), lo), scale);
+        v0 = _mm256_min_pd(_mm256_max_pd(v0, zero), hi);
+        v1 = _mm256_min_pd(_mm256_max_pd(v1, zero), hi);
+        __m256i b = _mm256_set_m128i(_mm256_cvttpd_epi32(v1), _mm256_cvttpd_epi32(v0));
+        b = _mm256_add_epi32(_mm256_sll_epi32(b, count), lane); // (bin << shift) + lane
+        _mm256_storeu_si256((__m256i *)(bins + i), b);
+    }
+    bins_uniform_scalar(spec, shift, data + i, n - i, bins + i);
+}
+
+__attribute__((target("avx512f")))
+static void bins_uniform_avx512(const hist_spec_t *spec, int shift, const double *data, size_t n, int *bins) {
+    const __m512d lo = _mm512_set1_pd(spec->min);
+    const __m512d scale = _mm512_set1_pd(spec->scale);
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d hi = _mm512_set1_pd(spec->nbins - 1);
+    const __m256i lane = _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32((1 << shift) - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(data + i), lo), scale);
+        v = _mm512_min_pd(_mm512_max_pd(v, zero), hi);
+        __m256i b = _mm256_add_epi32(_mm256_sll_epi32(_mm512_cvttpd_epi32(v), count), lane);
+        _mm256_storeu_si256((__m256i *)(bins + i), b);
+    }
+    bins_uniform_scalar(spec, shift, data + i, n - i, bins + i);
+}
+
+/* last index in [lo, lo + count) whose edge is <= x, lo if there is none */
+static inline int search_edges(const double *edges, int lo, int count, double x) {
+    const double *base = edges + lo;
+    while (count > 1) {
+        int half = count / 2;
+        base += (base[half] <= x) * half;
+        count -= half;
+    }
+    return (int)(base - edges);
+}
+
+static inline int edge_bin(const hist_spec_t *spec, double x) {
+    double v = (x - spec->min) * spec->lut_scale;
+    double last = spec->lut_cells - 1;
+    v = v > 0.0 ? v : 0.0;
+    v = v < last ? v : last;
+    int c = (int)v;
+
+    // the grid cell narrows x to a window of search_width edges starting at lut[c];
+    // a fixed width keeps the trip count, and so the loop branch, the same for every value
+    const double *base = spec->edges + spec->lut[c];
+    for (int half = spec->search_width / 2; half > 0; half /= 2) {
+        base += (base[half] <= x) * half;
+    }
+    int bin = (int)(base - spec->edges);
+    return bin < spec->nbins - 1 ? bin : spec->nbins - 1;
+}
+
+static void bins_edges(const hist_spec_t *spec, int shift, const double *data, size_t n, int *bins) {
+    int mask = (1 << shift) - 1;
+    for (size_t i = 0; i < n; i++) {
+        bins[i] = (edge_bin(spec, data[i]) << shift) + (i & mask);
+    }
+}
+
+/* ---------------- counting ---------------- */
+
+/*
+ * Direct strategy: value i bumps copy (i & mask) of its bin. The vector
+ * versions take the eight offsets of a group straight out of the register.
+ */
+
+static void count_uniform_scalar(const hist_spec_t *spec, int shift, const double *data, size_t n, int *counts) {
+    int mask = (1 << shift) - 1;
+    for (size_t i = 0; i < n; i++) {
+        counts[(uniform_bin(spec, data[i]) << shift) + (i & mask)]++;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void count_lanes(int *counts, __m256i offsets) {
+    __m128i lo = _mm256_castsi256_si128(offsets);
+    __m128i hi = _mm256_extracti128_si256(offsets, 1);
+    counts[_mm_cvtsi128_si32(lo)]++;
+    counts[_mm_extract_epi32(lo, 1)]++;
+    counts[_mm_extract_epi32(lo, 2)]++;
+    counts[_mm_extract_epi32(lo, 3)]++;
+    counts[_mm_cvtsi128_si32(hi)]++;
+    counts[_mm_extract_epi32(hi, 1)]++;
+    counts[_mm_extract_epi32(hi, 2)]++;
+    counts[_mm_extract_epi32(hi, 3)]++;
+}
+
+__attribute__((target("avx2")))
+static void count_uniform_avx2(const hist_spec_t *spec, int shift, const double *data, size_t n, int *counts) {
+    const __m256d lo = _mm256_set1_pd(spec->min);
+    const __m256d scale = _mm256_set1_pd(spec->scale);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d hi = _mm256_set1_pd(spec->nbins - 1);
+    const __m256i lane = _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32((1 << shift) - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d v0 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(data + i), lo), scale);
+        __m256d v1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(data + i + 4), lo), scale);
+        v0 = _mm256_min_pd(_mm256_max_pd(v0, zero), hi);
+        v1 = _mm256_min_pd(_mm256_max_pd(v1, zero), hi);
+        __m256i b = _mm256_set_m128i(_mm256_cvttpd_epi32(v1), _mm256_cvttpd_epi32(v0));
+        count_lanes(counts, _mm256_add_epi32(_mm256_sll_epi32(b, count), lane));
+    }
+    count_uniform_scalar(spec, shift, data + i, n - i, counts);
+}
+
+__attribute__((target("avx512f")))
+static void count_uniform_avx512(const hist_spec_t *spec, int shift, const double *data, size_t n, int *counts) {
+    const __m512d lo = _mm512_set1_pd(spec->min);
+    const __m512d scale = _mm512_set1_pd(spec->scale);
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d hi = _mm512_set1_pd(spec->nbins - 1);
+    const __m256i lane = _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32((1 << shift) - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(data + i), lo), scale);
+        v = _mm512_min_pd(_mm512_max_pd(v, zero), hi);
+        count_lanes(counts, _mm256_add_epi32(_mm256_sll_epi32(_mm512_cvttpd_epi32(v), count), lane));
+    }
+    count_uniform_scalar(spec, shift, data + i, n - i, counts);
+}
+
+static void count_edges(const hist_spec_t *spec, int shift, const double *data, size_t n, int *counts) {
+    int mask = (1 << shift) - 1;
+    for (size_t i = 0; i < n; i++) {
+        counts[(edge_bin(spec, data[i]) << shift) + (i & mask)]++;
+    }
+}
+
+static void count_partitioned(hist_ctx_t *ctx, size_t n) {
+    size_t *part_size = ctx->part_count;
+    size_t *cursor = ctx->part_count + ctx->num_parts;
+    memset(part_size, 0, ctx->num_parts * sizeof(size_t));
+
+    for (size_t i = 0; i < n; i++) {
+        part_size[ctx->bins[i] >> PARTITION_SLICE_SHIFT]++;
+    }
+    size_t offset = 0;
+    for (int p = 0; p < ctx->num_parts; p++) {
+        cursor[p] = offset;
+        offset += part_size[p];
+    }
+    for (size_t i = 0; i < n; i++) {
+        int b = ctx->bins[i];
+        ctx->scratch[cursor[b >> PARTITION_SLICE_SHIFT]++] = b;
+    }
+
+    // partition by partition, each touching a 128 KB slice of the table
+    for (size_t i = 0; i < n; i++) {
+        ctx->counts[ctx->scratch[i]]++;
+    }
+}
+
+/* ---------------- setup ---------------- */
+
+void hist_kernel_init(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        kernel_name = "avx512";
+        uniform_bins = bins_uniform_avx512;
+        uniform_count = count_uniform_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        kernel_name = "avx2";
+        uniform_bins = bins_uniform_avx2;
+        uniform_count = count_uniform_avx2;
+    } else {
+        kernel_name = "scalar";
+        uniform_bins = bins_uniform_scalar;
+        uniform_count = count_uniform_scalar;
+    }
+}
+
+const char *hist_kernel_name(void) {
+    return kernel_name;
+}
+
+int hist_spec_uniform(hist_spec_t *spec, int nbins, double min, double max) {
+    if (nbins <= 0 || !(max > min)) {
+        fprintf(stderr, "need at least one bin and min < max\n");
+        return -1;
+    }
+    memset(spec, 0, sizeof(*spec));
+    spec->nbins = nbins;
+    spec->min = min;
+    spec->max = max;
+    spec->scale = nbins / (max - min);
+    return 0;
+}
+
+int hist_spec_edges(hist_spec_t *spec, double *edges, int nbins) {
+    if (nbins <= 0 || !(edges[nbins] > edges[0])) {
+        fprintf(stderr, "need at least two edges spanning a non-empty range\n");
+        free(edges);
+        return -1;
+    }
+    for (int b = 0; b < nbins; b++) {
+        if (!(edges[b] <= edges[b + 1])) {
+            fprintf(stderr, "edges must be sorted (edge %d > edge %d)\n", b, b + 1);
+            free(edges);
+            return -1;
+        }
+    }
+
+    memset(spec, 0, sizeof(*spec));
+    spec->nbins = nbins;
+    spec->edges = edges;
+    spec->min = edges[0];
+    spec->max = edges[nbins];
+    spec->scale = nbins / (spec->max - spec->min);
+
+    // grid of 2 cells per bin: lut[c] is the bin holding the left end of cell c
+    spec->lut_cells = nbins * 2 < MAX_LUT_CELLS ? nbins * 2 : MAX_LUT_CELLS;
+    spec->lut_scale = spec->lut_cells / (spec->max - spec->min);
+    spec->lut = (int *)malloc((spec->lut_cells + 1) * sizeof(int));
+    if (spec->lut == NULL) {
+        perror("malloc failed for edge table");
+        free(edges);
+        return -1;
+    }
+    for (int c = 0; c <= spec->lut_cells; c++) {
+        double left = spec->min + c / spec->lut_scale;
+        spec->lut[c] = search_edges(edges, 0, nbins, left);
+    }
+
+    // a value computed to be in cell c may be one cell off either way after rounding, so
+    // each window starts one cell early and must reach the bin of cell c + 2
+    int widest = 1;
+    for (int c = 0; c < spec->lut_cells; c++) {
+        int last = spec->lut[c + 2 < spec->lut_cells ? c + 2 : spec->lut_cells];
+        int width = last - spec->lut[c > 0 ? c - 1 : 0] + 1;
+        if (width > widest) widest = width;
+    }
+    spec->search_width = 1;
+    while (spec->search_width < widest) spec->search_width *= 2;
+    for (int c = spec->lut_cells; c > 0; c--) {
+        spec->lut[c] = spec->lut[c - 1];
+    }
+
+    // pad with +inf so a window starting near the end never reads past the table
+    double *padded = (double *)realloc(edges, (nbins + 1 + spec->search_width) * sizeof(double));
+    if (padded == NULL) {
+        perror("realloc failed for edge table");
+        hist_spec_free(spec);
+        return -1;
+    }
+    for (int e = nbins + 1; e < nbins + 1 + spec->search_width; e++) {
+        padded[e] = INFINITY;
+    }
+    spec->edges = padded;
+    return 0;
+}
+
+void hist_spec_free(hist_spec_t *spec) {
+    free(spec->edges);
+    free(spec->lut);
+    spec->edges = NULL;
+    spec->lut = NULL;
+}
+
+int hist_ctx_init(hist_ctx_t *ctx, const hist_spec_t *spec) {
+    size_t table_bytes = (size_t)spec->nbins * sizeof(int);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->spec = spec;
+
+    if (table_bytes > PARTITION_MIN_BYTES) {
+        ctx->strategy = HIST_PARTITIONED;
+        ctx->num_parts = (spec->nbins >> PARTITION_SLICE_SHIFT) + 1;
+        ctx->counts = (int *)calloc(spec->nbins, sizeof(int));
+        ctx->bins = (int *)malloc(PARTITIONED_BATCH * sizeof(int));
+        ctx->scratch = (int *)malloc(PARTITIONED_BATCH * sizeof(int));
+        ctx->part_count = (size_t *)malloc(2 * ctx->num_parts * sizeof(size_t));
+        if (ctx->scratch == NULL || ctx->part_count == NULL) {
+            hist_ctx_free(ctx);
+            return -1;
+        }
+    } else {
+        ctx->strategy = HIST_DIRECT;
+        ctx->shift = table_bytes * SUB_HISTS <= SUB_HISTS_MAX_BYTES ? 3 : 0;
+        ctx->counts = (int *)calloc((size_t)spec->nbins << ctx->shift, sizeof(int));
+    }
+
+    if (ctx->counts == NULL || (ctx->strategy == HIST_PARTITIONED && ctx->bins == NULL)) {
+        hist_ctx_free(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+void hist_ctx_free(hist_ctx_t *ctx) {
+    free(ctx->counts);
+    free(ctx->bins);
+    free(ctx->scratch);
+    free(ctx->part_count);
+    ctx->counts = NULL;
+    ctx->bins = NULL;
+    ctx->scratch = NULL;
+    ctx->part_count = NULL;
+}
+
+const char *hist_strategy_name(const hist_ctx_t *ctx) {
+    if (ctx->strategy == HIST_PARTITIONED) return "partitioned";
+    return ctx->shift > 0 ? "direct-x8" : "direct";
+}
+
+void hist_ctx_add(hist_ctx_t *ctx, const double *data, size_t n) {
+    const hist_spec_t *spec = ctx->spec;
+    if (ctx->strategy == HIST_DIRECT) {
+        if (spec->edges != NULL) count_edges(spec, ctx->shift, data, n, ctx->counts);
+        else uniform_count(spec, ctx->shift, data, n, ctx->counts);
+        return;
+    }
+
+    for (size_t done = 0; done < n; done += PARTITIONED_BATCH) {
+        size_t len = n - done < PARTITIONED_BATCH ? n - done : PARTITIONED_BATCH;
+        if (spec->edges != NULL) bins_edges(spec, 0, data + done, len, ctx->bins);
+        else uniform_bins(spec, 0, data + done, len, ctx->bins);
+        count_partitioned(ctx, len);
+    }
+}
+
+void hist_ctx_flush(hist_ctx_t *ctx, int *hist) {
+    int num_copies = 1 << ctx->shift;
+    for (int b = 0; b < ctx->spec->nbins; b++) {
+        int *copies = ctx->counts + ((size_t)b << ctx->shift);
+        for (int l = 0; l < num_copies; l++) {
+            hist[b] += copies[l];
+            copies[l] = 0;
+        }
+    }
+}
+
+void hist_scalar(const hist_spec_t *spec, const double *data, size_t n, int *hist) {
+    int nbins = spec->nbins;
+    for (size_t i = 0; i < n; i++) {
+        int bin;
+        if (spec->edges == NULL) {
+            bin = (int)((data[i] - spec->min) * spec->scale);
+        } else { // upper bound search, one branch per level
+            int lo = 0, hi = nbins;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (spec->edges[mid + 1] <= data[i]) lo = mid + 1;
+                else hi = mid;
+            }
+            bin = lo;
+        }
+        if (bin >= nbins) bin = nbins - 1;
+        if (bin < 0) bin = 0;
+        hist[bin]++;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef HIST_KERNEL_H
+#define HIST_KERNEL_H
+
+#include <stddef.h>
+
+/*
+ * Branch-free binning kernel.
+ *
+ * Bins are either nbins uniform bins over [min, max) or nbins bins between
+ * nbins + 1 user-supplied sorted edges, bin b being [edges[b], edges[b + 1]).
+ * Values below the first bin are counted in bin 0 and values at or past the
+ * last edge in bin nbins - 1 (the original program put 1.0 in the last bin).
+ *
+ * Uniform bins are computed eight at a time with AVX-512 or AVX2 (scalar
+ * fallback): subtract, multiply, truncate, clamp with min/max. Edges are found
+ * through a lookup table over a uniform grid that narrows each value down to a
+ * few candidate bins, followed by a branchless binary search of fixed depth.
+ *
+ * Counting picks one of two strategies from the table size:
+ *  - direct: lane l of every group of eight bumps its own copy of the bin, so
+ *    back-to-back values in the same bin do not wait on store-to-load
+ *    forwarding. Copies are interleaved bin-major and folded on flush. Once
+ *    eight copies would outgrow 64 KB a single copy is kept. Bins are
+ *    computed and counted in the same loop, without a buffer in between.
+ *  - partitioned: for tables bigger than L2, a batch of bin numbers is first
+ *    radix-partitioned on its high bits, then counted one partition at a time,
+ *    so each pass only touches a slice of the table that stays cache resident.
+ */
+
+#define SUB_HISTS 8
+#define SUB_HISTS_MAX_BYTES (64 * 1024)
+#define PARTITION_MIN_BYTES (1024 * 1024)   // tables above this are counted partitioned
+#define PARTITION_SLICE_SHIFT 15            // each partition covers 2^15 bins (128 KB of counters)
+
+typedef struct {
+    int nbins;
+    double min, max;     // uniform range, also edges[0] and edges[nbins] when edges are given
+    double scale;        // nbins / (max - min)
+    double *edges;       // nbins + 1 sorted edges then +inf padding, NULL for uniform bins
+    int *lut;            // edges only: first candidate bin for each grid cell, lut_cells + 1 entries
+    int lut_cells;
+    double lut_scale;    // lut_cells / (max - min)
+    int search_width;    // power of two covering the widest window of candidate bins
+} hist_spec_t;
+
+enum hist_strategy { HIST_DIRECT, HIST_PARTITIONED };
+
+typedef struct {
+    const hist_spec_t *spec;
+    enum hist_strategy strategy;
+    int shift;           // direct: log2 of the number of copies, 3 (SUB_HISTS) or 0
+    int *counts;         // direct: counts[(bin << shift) + lane]; partitioned: counts[bin]
+    int *bins;           // partitioned: bin numbers of the current batch
+    int *scratch;        // partitioned: the batch reordered by partition
+    int num_parts;
+    size_t *part_count;
+} hist_ctx_t;
+
+/* picks AVX-512, AVX2 or scalar code through CPUID */
+void hist_kernel_init(void);
+const char *hist_kernel_name(void);
+
+int hist_spec_uniform(hist_spec_t *spec, int nbins, double min, double max);
+/* takes ownership of edges (nbins + 1 sorted values, malloc'd) */
+int hist_spec_edges(hist_spec_t *spec, double *edges, int nbins);
+void hist_spec_free(hist_spec_t *spec);
+
+int hist_ctx_init(hist_ctx_t *ctx, const hist_spec_t *spec);
+void hist_ctx_free(hist_ctx_t *ctx);
+const char *hist_strategy_name(const hist_ctx_t *ctx);
+
+/* bins data[0..n) into the context's private tables */
+void hist_ctx_add(hist_ctx_t *ctx, const double *data, size_t n);
+
+/* adds the private tables into hist[0..nbins) and clears them */
+void hist_ctx_flush(hist_ctx_t *ctx, int *hist);
+
+/* the original loop: one value at a time, branches on the edges, single histogram */
+void hist_scalar(const hist_spec_t *spec, const double *data, size_t n, int *hist);
+
+#endif
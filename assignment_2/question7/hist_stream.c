@@ -0,0 +1,158 @@
+#include "hist_stream.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_secs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * Fills buf with up to len doubles. Pipes hand out whatever is available, so
+ * read() is repeated until the block is full or the input ends. Returns the
+ * number of whole doubles read, -1 on error.
+ */
+static long read_block(int fd, double *buf, size_t len) {
+    char *bytes = (char *)buf;
+    size_t want = len * sizeof(double), got = 0;
+    while (got < want) {
+        ssize_t r = read(fd, bytes + got, want - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) {
+            perror("read failed");
+            return -1;
+        }
+        if (r == 0) break;
+        got += r;
+    }
+    if (got % sizeof(double) != 0) {
+        fprintf(stderr, "input ends with %zu stray bytes, ignored\n", got % sizeof(double));
+    }
+    return (long)(got / sizeof(double));
+}
+
+static void *stream_worker_func(void *arg) {
+    stream_worker_t *self = (stream_worker_t *)arg;
+    hist_stream_t *s = self->stream;
+
+    for (;;) {
+        pthread_barrier_wait(&s->barrier); // a block was published
+        if (s->done) break;
+
+        size_t begin = s->current_len * self->id / s->num_threads;
+        size_t end = s->current_len * (self->id + 1) / s->num_threads;
+        hist_ctx_add(&self->ctx, s->current + begin, end - begin);
+        if (s->snapshot) hist_ctx_flush(&self->ctx, self->partial);
+
+        pthread_barrier_wait(&s->barrier); // the block can be overwritten
+    }
+    hist_ctx_flush(&self->ctx, self->partial);
+    return NULL;
+}
+
+static void sum_partials(hist_stream_t *s) {
+    memset(s->total, 0, s->spec->nbins * sizeof(int));
+    for (int w = 0; w < s->num_threads; w++) {
+        for (int b = 0; b < s->spec->nbins; b++) {
+            s->total[b] += s->workers[w].partial[b];
+        }
+    }
+}
+
+int hist_stream_init(hist_stream_t *s, const hist_spec_t *spec, int num_threads, size_t block_len) {
+    memset(s, 0, sizeof(*s));
+    s->spec = spec;
+    s->num_threads = num_threads;
+    s->block_len = block_len;
+    s->blocks[0] = (double *)malloc(block_len * sizeof(double));
+    s->blocks[1] = (double *)malloc(block_len * sizeof(double));
+    s->total = (int *)calloc(spec->nbins, sizeof(int));
+    s->workers = (stream_worker_t *)calloc(num_threads, sizeof(stream_worker_t));
+    if (s->blocks[0] == NULL || s->blocks[1] == NULL || s->total == NULL || s->workers == NULL) {
+        perror("malloc failed for stream buffers");
+        hist_stream_free(s);
+        return -1;
+    }
+
+    for (int w = 0; w < num_threads; w++) {
+        stream_worker_t *worker = &s->workers[w];
+        worker->stream = s;
+        worker->id = w;
+        worker->partial = (int *)calloc(spec->nbins, sizeof(int));
+        if (worker->partial == NULL || hist_ctx_init(&worker->ctx, spec) != 0) {
+            perror("calloc failed for worker tables");
+            hist_stream_free(s);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void hist_stream_free(hist_stream_t *s) {
+    if (s->workers != NULL) {
+        for (int w = 0; w < s->num_threads; w++) {
+            hist_ctx_free(&s->workers[w].ctx);
+            free(s->workers[w].partial);
+        }
+    }
+    free(s->workers);
+    free(s->blocks[0]);
+    free(s->blocks[1]);
+    free(s->total);
+    s->workers = NULL;
+    s->blocks[0] = s->blocks[1] = NULL;
+    s->total = NULL;
+}
+
+int hist_stream_run(hist_stream_t *s, int fd, double snapshot_secs, hist_snapshot_fn fn, void *arg) {
+    pthread_barrier_init(&s->barrier, NULL, s->num_threads + 1);
+    s->done = 0;
+    for (int w = 0; w < s->num_threads; w++) {
+        if (pthread_create(&s->workers[w].thread, NULL, stream_worker_func, &s->workers[w]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
+        }
+    }
+
+    double start = now_secs(), last_snapshot = start;
+    int cur = 0;
+    long len = read_block(fd, s->blocks[cur], s->block_len);
+    s->read_secs += now_secs() - start;
+
+    while (len > 0) {
+        s->current = s->blocks[cur];
+        s->current_len = len;
+        s->snapshot = snapshot_secs > 0 && now_secs() - last_snapshot >= snapshot_secs;
+        pthread_barrier_wait(&s->barrier); // workers start on blocks[cur]
+
+        double t0 = now_secs();
+        long next_len = read_block(fd, s->blocks[1 - cur], s->block_len);
+        double t1 = now_secs();
+        pthread_barrier_wait(&s->barrier); // workers are done with blocks[cur]
+        s->read_secs += t1 - t0;
+        s->stall_secs += now_secs() - t1;
+        s->values += len;
+
+        if (s->snapshot) {
+            last_snapshot = now_secs();
+            sum_partials(s);
+            fn(s->total, s->values, last_snapshot - start, arg);
+        }
+        cur = 1 - cur;
+        len = next_len;
+    }
+
+    s->done = 1;
+    pthread_barrier_wait(&s->barrier);
+    for (int w = 0; w < s->num_threads; w++) {
+        pthread_join(s->workers[w].thread, NULL);
+    }
+    pthread_barrier_destroy(&s->barrier);
+    sum_partials(s);
+    return len < 0 ? -1 : 0;
+}
@@ -0,0 +1,59 @@
+#ifndef HIST_STREAM_H
+#define HIST_STREAM_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "hist_kernel.h"
+
+/*
+ * Streaming histogram over raw native doubles read from a file descriptor
+ * (a file, a pipe or stdin), in fixed blocks of block_len values.
+ *
+ * Two blocks are kept: while the workers bin block k, each its own slice of it,
+ * the main thread reads block k + 1 into the other buffer. A barrier with all
+ * workers and the reader marks the start and the end of every round, so memory
+ * stays at two blocks plus the bin tables whatever the input size.
+ *
+ * Every snapshot_secs the workers flush their private tables at the end of the
+ * round and the callback sees the running histogram.
+ */
+
+#define STREAM_DEFAULT_BLOCK (1 << 18) // doubles per block, 2 MB
+
+typedef void (*hist_snapshot_fn)(const int *hist, long long values, double secs, void *arg);
+
+typedef struct hist_stream hist_stream_t;
+
+typedef struct {
+    hist_stream_t *stream;
+    int id;
+    pthread_t thread;
+    hist_ctx_t ctx;
+    int *partial;      // this worker's counts, filled at snapshots and at the end
+} stream_worker_t;
+
+struct hist_stream {
+    const hist_spec_t *spec;
+    int num_threads;
+    size_t block_len;
+    double *blocks[2];
+    const double *current;   // the block being binned this round
+    size_t current_len;
+    int snapshot;            // flush the private tables at the end of this round
+    int done;
+    pthread_barrier_t barrier;
+    stream_worker_t *workers;
+    int *total;              // the histogram: latest snapshot, final after hist_stream_run
+
+    long long values;
+    double read_secs;        // main thread inside read()
+    double stall_secs;       // main thread waiting for the workers after its read
+};
+
+int hist_stream_init(hist_stream_t *s, const hist_spec_t *spec, int num_threads, size_t block_len);
+void hist_stream_free(hist_stream_t *s);
+
+/* bins everything up to end of file; snapshot_secs <= 0 means no snapshots */
+int hist_stream_run(hist_stream_t *s, int fd, double snapshot_secs, hist_snapshot_fn fn, void *arg);
+
+#endif
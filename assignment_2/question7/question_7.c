@@ -1,55 +1,196 @@
-#define _POSIX_C_SOURCE 199309L
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include "placement.h"
+#include "ws_sched.h"
+#include "hist_kernel.h"
+#include "hist_stream.h"
 
-#define NUM_BINS 30
+#define DEFAULT_BINS 30
+#define DEFAULT_CHUNK 16384 /* work-stealing chunk, in doubles */
+#define USAGE "Usage: %s [--pin | --numa] [--steal [--chunk doubles]] [--scalar | --bench] [--bins N] [--range min:max | --edges file] <num_threads> <array_size>\n" \
+              "       %s [--bins N] [--range min:max | --edges file] --stream <file | -> [--block doubles] [--snapshot secs] <num_threads>\n"
 
 int num_threads = 0;
 long array_size = 0;
 double *data_array; 
+topology_t topology;
+enum placement_mode placement = PLACE_NONE;
+worker_stat_t *worker_stats; /* where each worker runs and how much it streamed */
+unsigned int init_seed;
+int use_steal = 0; /* --steal: hand out fixed chunks through the work-stealing scheduler */
+ws_sched_t sched;
+int use_scalar = 0; /* --scalar: the original one-bin-at-a-time loop instead of the SIMD kernel */
+int num_bins = DEFAULT_BINS;
+hist_spec_t spec; /* bin layout shared by every thread: uniform over [min, max) or explicit edges */
+
+/* what a thread bins into */
+typedef struct {
+    hist_ctx_t ctx; // interleaved sub-histograms for the SIMD kernel
+    int *hist;      // plain histogram, filled directly by the scalar loop
+} binner_t;
 
 void *thread_func(void *arg); /* the fucntion that each created thread executes individually */
+void *init_thread_func(void *arg); /* first-touches one slice of data_array from its future consumer */
+void bin_range(binner_t *binner, long start_index, long end_index);
+int bins_scalar(const hist_ctx_t *ctx); /* whether a binner with this context uses the original loop */
+void run_bench(void);
+double *read_edges(const char *path, int *nbins);
+int run_stream(const char *path, size_t block_len, double snapshot_secs);
+
+static void thread_bounds(int my_id, long *start_index, long *end_index) {
+    // bound calculation for each thread
+    long chunk_size = array_size / num_threads;
+    *start_index = my_id * chunk_size;
+    *end_index = *start_index + chunk_size;
+
+    //remainder for the last thread needs to be treated if the number of threads dont evenly divide the array size
+    if (my_id == num_threads - 1) {
+        *end_index = array_size;
+    }
+}
 
 void print_histogram(int *hist) { /*helper for printing histogram on terminal*/
     printf("Histogram:\n");
-    for (int i = 0; i < NUM_BINS; i++) {
+    for (int i = 0; i < num_bins; i++) {
         printf("Bin %2d: %d\n", i, hist[i]);
     }
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3) {
-        printf("Usage: %s <num_threads> <array_size>\n", argv[0]);
+    static struct option long_options[] = {
+        {"pin", no_argument, NULL, 'p'},   /* pin worker i to the i-th CPU */
+        {"numa", no_argument, NULL, 'n'},  /* spread workers over NUMA nodes */
+        {"steal", no_argument, NULL, 'w'}, /* work-stealing chunks instead of one static slice per thread */
+        {"chunk", required_argument, NULL, 'k'},
+        {"scalar", no_argument, NULL, 's'}, /* original scalar loop */
+        {"bench", no_argument, NULL, 'b'},  /* scalar loop vs SIMD kernel over a range of bin counts */
+        {"bins", required_argument, NULL, 'B'},
+        {"range", required_argument, NULL, 'r'}, /* min:max of the uniform bins, default 0:1 */
+        {"edges", required_argument, NULL, 'e'}, /* text file of sorted bin edges, overrides --bins and --range */
+        {"stream", required_argument, NULL, 'S'}, /* bin raw doubles from a file or - for stdin, block by block */
+        {"block", required_argument, NULL, 'l'},  /* doubles per stream block */
+        {"snapshot", required_argument, NULL, 'i'}, /* seconds between running histograms while streaming */
+        {NULL, 0, NULL, 0}
+    };
+    long steal_chunk = DEFAULT_CHUNK;
+    int bench = 0;
+    double range_min = 0.0, range_max = 1.0;
+    const char *edges_path = NULL;
+    const char *stream_path = NULL;
+    long block_len = STREAM_DEFAULT_BLOCK;
+    double snapshot_secs = 0.0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 'p') placement = PLACE_PIN;
+        else if (opt == 'n') placement = PLACE_NUMA;
+        else if (opt == 'w') use_steal = 1;
+        else if (opt == 'k') steal_chunk = atol(optarg);
+        else if (opt == 's') use_scalar = 1;
+        else if (opt == 'b') bench = 1;
+        else if (opt == 'B') num_bins = atoi(optarg);
+        else if (opt == 'r' && sscanf(optarg, "%lf:%lf", &range_min, &range_max) == 2) continue;
+        else if (opt == 'e') edges_path = optarg;
+        else if (opt == 'S') stream_path = optarg;
+        else if (opt == 'l') block_len = atol(optarg);
+        else if (opt == 'i') snapshot_secs = atof(optarg);
+        else {
+            printf(USAGE, argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    // the stream mode always bins with the SIMD kernel, so --scalar and --bench do not combine with it
+    if (argc - optind != (stream_path != NULL ? 1 : 2) || steal_chunk <= 0 || block_len <= 0 ||
+        (stream_path != NULL && (use_scalar || bench)) || atoi(argv[optind]) <= 0) {
+        printf(USAGE, argv[0], argv[0]);
+        return 1;
+    }
+
+    if (edges_path != NULL) {
+        double *edges = read_edges(edges_path, &num_bins);
+        if (edges == NULL || hist_spec_edges(&spec, edges, num_bins) != 0) {
+            return 1;
+        }
+    } else if (hist_spec_uniform(&spec, num_bins, range_min, range_max) != 0) {
         return 1;
     }
 
-    num_threads = atoi(argv[1]);
-    array_size = atol(argv[2]);
+    hist_kernel_init();
+    num_threads = atoi(argv[optind]);
+    if (stream_path != NULL) {
+        int status = run_stream(stream_path, block_len, snapshot_secs);
+        hist_spec_free(&spec);
+        return status;
+    }
+    array_size = atol(argv[optind + 1]);
+
+    if (topology_load(&topology) != 0) {
+        return 1;
+    }
+    worker_stats = (worker_stat_t *)aligned_alloc(CACHE_LINE, num_threads * sizeof(worker_stat_t));
 
     /*random doubles values array */
     data_array = (double *)malloc(array_size * sizeof(double));
 
-    srand(time(NULL));
-    for (long i = 0; i < array_size; i++) {
-        data_array[i] = (double)rand() / (double)RAND_MAX; // Random double in [0,1]
+    pthread_t *workers = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    int *thread_ids = (int *)malloc(num_threads * sizeof(int)); 
+
+    init_seed = time(NULL);
+    if (placement != PLACE_NONE) {
+        // each slice is first touched by a thread pinned where its histogram worker will run,
+        // so the pages are allocated on that worker's node
+        for (int i = 0; i < num_threads; i++) {
+            thread_ids[i] = i;
+            if (pthread_create(&workers[i], NULL, init_thread_func, &thread_ids[i]) != 0) {
+                perror("Failed to create thread");
+            }
+        }
+        for (int i = 0; i < num_threads; i++) {
+            pthread_join(workers[i], NULL);
+        }
+    } else {
+        srand(init_seed);
+        for (long i = 0; i < array_size; i++) {
+            data_array[i] = spec.min + (spec.max - spec.min) * ((double)rand() / (double)RAND_MAX); // Random double in [min,max]
+        }
+    }
+
+    if (bench) {
+        run_bench();
+        free(data_array);
+        free(workers);
+        free(thread_ids);
+        free(worker_stats);
+        topology_free(&topology);
+        hist_spec_free(&spec);
+        return 0;
     }
 
     // --- Serial Histogram ---
-    printf("--- Serial Calculation ---\n");
-    int serial_hist[NUM_BINS] = {0};
+    int *serial_hist = (int *)calloc(num_bins, sizeof(int));
+    binner_t serial_binner = {.hist = serial_hist};
+    if (serial_hist == NULL || hist_ctx_init(&serial_binner.ctx, &spec) != 0) {
+        perror("calloc failed");
+        return 1;
+    }
+    printf("--- Serial Calculation (%s) ---\n", bins_scalar(&serial_binner.ctx) ? "scalar loop" : hist_kernel_name());
+    if (!bins_scalar(&serial_binner.ctx)) {
+        printf("Bin counting: %s\n", hist_strategy_name(&serial_binner.ctx));
+    }
     struct timespec start_serial, end_serial;
 
     clock_gettime(CLOCK_MONOTONIC, &start_serial); // start time for serially generating histogram
     
-    for (long i = 0; i < array_size; i++) {
-        int bin = (int)(data_array[i] * NUM_BINS);
-        if (bin >= NUM_BINS) bin = NUM_BINS - 1; 
-        serial_hist[bin]++;
-    }
+    bin_range(&serial_binner, 0, array_size);
+    hist_ctx_flush(&serial_binner.ctx, serial_hist);
     
     clock_gettime(CLOCK_MONOTONIC, &end_serial);// end time for serially generating histogram
 
@@ -58,12 +199,14 @@ int main(int argc, char *argv[])
 
     print_histogram(serial_hist);
     printf("Serial time = %.5f seconds\n\n", time_serial);
+    hist_ctx_free(&serial_binner.ctx);
 
     // --- Parallel Histogram ---
     printf("--- Parallel Calculation ---\n");
-    pthread_t *workers = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
-    int *thread_ids = (int *)malloc(num_threads * sizeof(int)); 
-    int parallel_hist[NUM_BINS] = {0};
+    int *parallel_hist = (int *)calloc(num_bins, sizeof(int));
+    if (use_steal && ws_init(&sched, array_size, steal_chunk, num_threads) != 0) {
+        return 1;
+    }
     
     struct timespec start_parallel, end_parallel;
     clock_gettime(CLOCK_MONOTONIC, &start_parallel); // start time for parallelly generating histogram
@@ -84,7 +227,7 @@ int main(int argc, char *argv[])
         if (retval != NULL) {
             int *partial_hist = (int *)retval;
             // Aggregate results
-            for (int j = 0; j < NUM_BINS; j++) { // aggregate partial histogram results into final histogram
+            for (int j = 0; j < num_bins; j++) { // aggregate partial histogram results into final histogram
                 parallel_hist[j] += partial_hist[j];
             }
             free(partial_hist); // Free the memory from the thread
@@ -98,39 +241,285 @@ int main(int argc, char *argv[])
 
     print_histogram(parallel_hist);
     printf("Parallel time = %.5f seconds\n", time_parallel);
+    if (placement != PLACE_NONE) {
+        printf("Placement: %s\n", placement_name(placement));
+        placement_report(&topology, worker_stats, num_threads);
+    }
+    if (use_steal) {
+        ws_report(&sched);
+        ws_free(&sched);
+    }
 
     /* free up resources properly */
+    free(serial_hist);
+    free(parallel_hist);
+    hist_spec_free(&spec);
     free(data_array);
     free(workers);
     free(thread_ids);
+    free(worker_stats);
+    topology_free(&topology);
 
     return 0;
 }
 
-void *thread_func(void *arg) {
+void *init_thread_func(void *arg) {
     int my_id = *(int*)arg;
+    placement_apply(&topology, placement_cpu(&topology, placement, my_id, num_threads), &worker_stats[my_id]);
 
-    // bound calculation for each thread
-    long chunk_size = array_size / num_threads;
-    long start_index = my_id * chunk_size;
-    long end_index = start_index + chunk_size;
+    long start_index, end_index;
+    thread_bounds(my_id, &start_index, &end_index);
 
-    //remainder for the last thread needs to be treated if the number of threads dont evenly divide the array size
-    if (my_id == num_threads - 1) {
-        end_index = array_size;
+    unsigned int seed = init_seed + my_id; // rand() is not thread safe, each thread gets its own stream
+    for (long i = start_index; i < end_index; i++) {
+        data_array[i] = spec.min + (spec.max - spec.min) * ((double)rand_r(&seed) / (double)RAND_MAX);
+    }
+    pthread_exit(NULL);
+}
+
+/*
+ * The kernel loses to the original loop on uniform bins counted partitioned
+ * (see --bench), so those stay on the loop; edge tables always take the kernel.
+ */
+int bins_scalar(const hist_ctx_t *ctx) {
+    return use_scalar || (spec.edges == NULL && ctx->strategy == HIST_PARTITIONED);
+}
+
+void bin_range(binner_t *binner, long start_index, long end_index) {
+    if (bins_scalar(&binner->ctx)) {
+        hist_scalar(&spec, data_array + start_index, end_index - start_index, binner->hist);
+    } else {
+        hist_ctx_add(&binner->ctx, data_array + start_index, end_index - start_index);
     }
+}
+
+/* work-stealing callback: bins one chunk for the calling worker, whose binner is passed as arg */
+static void bin_chunk(int worker, size_t begin, size_t end, void *arg) {
+    bin_range((binner_t *)arg, begin, end);
+    worker_stats[worker].bytes += (end - begin) * sizeof(double);
+}
+
+void *thread_func(void *arg) {
+    int my_id = *(int*)arg;
+    placement_apply(&topology, placement_cpu(&topology, placement, my_id, num_threads), &worker_stats[my_id]);
+
+    long start_index, end_index;
+    thread_bounds(my_id, &start_index, &end_index);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
     //partial histogram for current thread
-    int *my_hist = (int *)calloc(NUM_BINS, sizeof(int));
-    if (my_hist == NULL) {
+    int *my_hist = (int *)calloc(num_bins, sizeof(int));
+    binner_t binner = {.hist = my_hist};
+    if (my_hist == NULL || hist_ctx_init(&binner.ctx, &spec) != 0) {
+        free(my_hist);
         pthread_exit(NULL);
     }
 
-    for (long i = start_index; i < end_index; i++) {
-        int bin = (int)(data_array[i] * NUM_BINS);
-        if (bin >= NUM_BINS) bin = NUM_BINS - 1; // Handle case where value is 1.0
-        my_hist[bin]++;
+    if (use_steal) {
+        worker_stats[my_id].bytes = 0;
+        ws_work(&sched, my_id, bin_chunk, &binner); // chunks of any slice, stolen ones included
+    } else {
+        bin_range(&binner, start_index, end_index);
+        worker_stats[my_id].bytes = (end_index - start_index) * sizeof(double);
     }
+    hist_ctx_flush(&binner.ctx, my_hist); // fold the sub-histograms
+    hist_ctx_free(&binner.ctx);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    worker_stats[my_id].secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     
     pthread_exit((void*)my_hist);
 }
+
+/* reads whitespace-separated sorted edges; n edges make n - 1 bins */
+double *read_edges(const char *path, int *nbins) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror("fopen failed for edges file");
+        return NULL;
+    }
+
+    int count = 0, capacity = 64;
+    double *edges = (double *)malloc(capacity * sizeof(double));
+    while (edges != NULL && fscanf(file, "%lf", &edges[count]) == 1) {
+        if (++count == capacity) {
+            capacity *= 2;
+            double *grown = (double *)realloc(edges, capacity * sizeof(double));
+            if (grown == NULL) free(edges);
+            edges = grown;
+        }
+    }
+    fclose(file);
+
+    if (edges == NULL || count < 2) {
+        fprintf(stderr, "%s: need at least two edges\n", path);
+        free(edges);
+        return NULL;
+    }
+    *nbins = count - 1;
+    return edges;
+}
+
+static double elapsed_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+/*
+ * Single-threaded comparison of the original loop and the SIMD kernel over the
+ * whole data_array, for bin counts from a few cache lines up to far beyond L2.
+ * Every count is run twice over the same range: as uniform bins, and as the
+ * same bins given through an edge table (lookup table + branchless search).
+ * Each variant gets one untimed pass (page faults, cache warm-up) and then the
+ * best of BENCH_RUNS timed passes is reported.
+ *
+ * Besides the uniform random data, the direct-strategy bin counts are also run
+ * over the same values sorted, and skewed towards the low end, where
+ * neighbouring values keep landing in the same bin and a single histogram
+ * waits on store-to-load forwarding.
+ */
+#define BENCH_RUNS 3
+#define BENCH_SKEWED_MAX_BINS 65536   // past this the tables are the cost, not repeated bins
+
+static void bench_spec(const hist_spec_t *bench_spec, const char *kind, const double *data) {
+    int nbins = bench_spec->nbins;
+    int *ref = (int *)calloc(nbins, sizeof(int));
+    int *hist = (int *)calloc(nbins, sizeof(int));
+    hist_ctx_t ctx;
+    if (ref == NULL || hist == NULL || hist_ctx_init(&ctx, bench_spec) != 0) {
+        perror("calloc failed");
+        exit(1);
+    }
+
+    double scalar_ns = 0.0, simd_ns = 0.0;
+    for (int run = 0; run <= BENCH_RUNS; run++) {
+        struct timespec t0, t1, t2;
+        memset(ref, 0, nbins * sizeof(int));
+        memset(hist, 0, nbins * sizeof(int));
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        hist_scalar(bench_spec, data, array_size, ref);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        hist_ctx_add(&ctx, data, array_size);
+        hist_ctx_flush(&ctx, hist);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+
+        if (run == 0) continue; // warm-up
+        if (run == 1 || elapsed_ns(t0, t1) < scalar_ns) scalar_ns = elapsed_ns(t0, t1);
+        if (run == 1 || elapsed_ns(t1, t2) < simd_ns) simd_ns = elapsed_ns(t1, t2);
+    }
+    scalar_ns /= array_size;
+    simd_ns /= array_size;
+
+    int match = 1;
+    for (int b = 0; b < nbins; b++) {
+        if (ref[b] != hist[b]) match = 0;
+    }
+    printf("%s,%d,%s,%s,%.3f,%.3f,%.2f,%s\n", kind, nbins, bench_spec->edges != NULL ? "edges" : "uniform",
+           hist_strategy_name(&ctx), scalar_ns, simd_ns, scalar_ns / simd_ns, match ? "yes" : "NO");
+
+    hist_ctx_free(&ctx);
+    free(ref);
+    free(hist);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void run_bench(void) {
+    static const int bin_counts[] = {8, 30, 256, 4096, 65536, 1 << 20, 1 << 22};
+    int num_counts = sizeof(bin_counts) / sizeof(bin_counts[0]);
+
+    // the same values in order, and pushed towards min (t^8: half of them fall in the lowest 1/256 of the range)
+    double *sorted = (double *)malloc(array_size * sizeof(double));
+    double *skewed = (double *)malloc(array_size * sizeof(double));
+    if (sorted == NULL || skewed == NULL) {
+        perror("malloc failed");
+        exit(1);
+    }
+    memcpy(sorted, data_array, array_size * sizeof(double));
+    qsort(sorted, array_size, sizeof(double), compare_doubles);
+    for (long i = 0; i < array_size; i++) {
+        double t = (data_array[i] - spec.min) / (spec.max - spec.min);
+        t *= t;
+        t *= t;
+        t *= t;
+        skewed[i] = spec.min + (spec.max - spec.min) * t;
+    }
+    const struct {
+        const char *kind;
+        const double *data;
+    } inputs[] = {{"random", data_array}, {"sorted", sorted}, {"skewed", skewed}};
+
+    printf("data,bins,layout,strategy,scalar_ns_per_value,%s_ns_per_value,speedup,match\n", hist_kernel_name());
+    for (int k = 0; k < 3; k++) {
+        for (int c = 0; c < num_counts; c++) {
+            int nbins = bin_counts[c];
+            if (k > 0 && nbins > BENCH_SKEWED_MAX_BINS) continue;
+            hist_spec_t uniform, edged;
+            double *edges = (double *)malloc((nbins + 1) * sizeof(double));
+            if (edges == NULL || hist_spec_uniform(&uniform, nbins, spec.min, spec.max) != 0) {
+                exit(1);
+            }
+            for (int b = 0; b <= nbins; b++) {
+                edges[b] = spec.min + (spec.max - spec.min) * b / nbins;
+            }
+            if (hist_spec_edges(&edged, edges, nbins) != 0) {
+                exit(1);
+            }
+
+            bench_spec(&uniform, inputs[k].kind, inputs[k].data);
+            bench_spec(&edged, inputs[k].kind, inputs[k].data);
+            hist_spec_free(&uniform);
+            hist_spec_free(&edged);
+        }
+    }
+    free(sorted);
+    free(skewed);
+}
+
+static void print_snapshot(const int *hist, long long values, double secs, void *arg) {
+    (void)arg;
+    printf("Snapshot at %.2f s, %lld values:", secs, values);
+    for (int b = 0; b < num_bins && b < 16; b++) {
+        printf(" %d", hist[b]);
+    }
+    printf(num_bins > 16 ? " ...\n" : "\n");
+    fflush(stdout);
+}
+
+/*
+ * Bins a stream of raw doubles (the format question_8 -w in assignment1 writes)
+ * without ever holding more than two blocks of it.
+ */
+int run_stream(const char *path, size_t block_len, double snapshot_secs) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open failed for stream");
+        return 1;
+    }
+
+    hist_stream_t stream;
+    if (hist_stream_init(&stream, &spec, num_threads, block_len) != 0) {
+        return 1;
+    }
+    printf("--- Streaming Calculation (%s, blocks of %zu doubles) ---\n", hist_kernel_name(), block_len);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = hist_stream_run(&stream, fd, snapshot_secs, print_snapshot, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    print_histogram(stream.total);
+    printf("Stream time = %.5f seconds, %lld values, %.1f MB/s\n", secs, stream.values,
+           stream.values * sizeof(double) / secs / 1e6);
+    printf("Reader: %.5f s in read(), %.5f s waiting for the workers\n", stream.read_secs, stream.stall_secs);
+
+    hist_stream_free(&stream);
+    if (fd != STDIN_FILENO) close(fd);
+    return status == 0 ? 0 : 1;
+}
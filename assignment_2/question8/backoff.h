@@ -0,0 +1,35 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+/*
+ * Randomized exponential backoff for CAS loops: after the k-th failure a
+ * thread pauses for a random number of spins below BACKOFF_MIN << k (capped at
+ * BACKOFF_MAX), so threads that collided on top spread out instead of all
+ * retrying into the same cache line again.
+ */
+
+#define BACKOFF_MIN 4
+#define BACKOFF_MAX 4096
+
+typedef struct {
+    unsigned limit;
+    unsigned seed;
+} backoff_t;
+
+static inline void backoff_init(backoff_t *b) {
+    b->limit = BACKOFF_MIN;
+    b->seed = (unsigned)(uintptr_t)b; // stack address: differs between threads
+}
+
+static inline void backoff_wait(backoff_t *b) {
+    b->seed = b->seed * 1103515245u + 12345u;
+    unsigned spins = (b->seed >> 16) % b->limit + 1;
+    for (unsigned i = 0; i < spins; i++) {
+        __builtin_ia32_pause();
+    }
+    if (b->limit < BACKOFF_MAX) b->limit *= 2;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "elim_stack.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static __thread unsigned slot_seed; // per-thread slot picker
+
+static elim_slot_t *pick_slot(elim_stack_t *s) {
+    if (slot_seed == 0) slot_seed = (unsigned)(uintptr_t)&slot_seed | 1;
+    slot_seed = slot_seed * 1103515245u + 12345u;
+    return &s->slots[(slot_seed >> 16) % s->num_slots];
+}
+
+int elim_stack_init(elim_stack_t *s, int max_threads) {
+    // about one slot per pair of threads: enough to spread out, few enough that pairs still meet
+    s->num_slots = max_threads / 2 > 0 ? max_threads / 2 : 1;
+    s->slots = (elim_slot_t *)aligned_alloc(CACHE_LINE, s->num_slots * sizeof(elim_slot_t));
+    if (s->slots == NULL) {
+        perror("aligned_alloc failed for elimination array");
+        return -1;
+    }
+    for (int i = 0; i < s->num_slots; i++) {
+        s->slots[i].offer = NULL;
+        s->slots[i].taken = 0;
+    }
+    return lf_stack_init(&s->stack, max_threads);
+}
+
+void elim_stack_destroy(elim_stack_t *s) {
+    lf_stack_destroy(&s->stack);
+    free(s->slots);
+    s->slots = NULL;
+}
+
+void elim_push(elim_stack_t *s, Node *node) {
+    while (!lf_try_push(&s->stack, node)) {
+        elim_slot_t *slot = pick_slot(s);
+        if (!__sync_bool_compare_and_swap(&slot->offer, NULL, node)) {
+            continue; // another push is waiting there, back to top
+        }
+
+        for (int i = 0; i < ELIM_SPINS; i++) {
+            // any change means a pop took it. Should the node be taken, freed, reused and
+            // offered here again by another push, the two pushes just trade nodes: each
+            // value still ends up either popped or on the stack, once
+            if (__atomic_load_n(&slot->offer, __ATOMIC_ACQUIRE) != node) return;
+            __builtin_ia32_pause();
+        }
+        if (!__sync_bool_compare_and_swap(&slot->offer, node, NULL)) {
+            return; // taken just before we withdrew
+        }
+    }
+}
+
+int elim_pop(elim_stack_t *s, hp_record_t *rec) {
+    int id;
+    while (!lf_try_pop(&s->stack, rec, &id)) {
+        elim_slot_t *slot = pick_slot(s);
+        Node *offer = __atomic_load_n(&slot->offer, __ATOMIC_ACQUIRE);
+        // the CAS only compares addresses; once it succeeds the node is ours
+        // and was never on the stack, so it can be freed right away
+        if (offer != NULL && __sync_bool_compare_and_swap(&slot->offer, offer, NULL)) {
+            __atomic_fetch_add(&slot->taken, 1, __ATOMIC_RELAXED);
+            id = offer->node_id;
+            node_free(offer);
+            break;
+        }
+    }
+    hp_clear(rec);
+    return id;
+}
+
+long elim_stack_eliminated(const elim_stack_t *s) {
+    long total = 0;
+    for (int i = 0; i < s->num_slots; i++) {
+        total += s->slots[i].taken;
+    }
+    return total;
+}
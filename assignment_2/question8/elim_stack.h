@@ -0,0 +1,41 @@
+#ifndef ELIM_STACK_H
+#define ELIM_STACK_H
+
+#include "lf_stack.h"
+
+/*
+ * Elimination-backoff stack (Hendler, Shavit, Yerushalmi 2004) on top of the
+ * lock-free stack.
+ *
+ * Every operation first tries the CAS on top. When that fails, instead of
+ * spinning on top again, the thread goes to a random slot of a side array: a
+ * push leaves its node there for up to ELIM_SPINS pauses, a pop that finds a
+ * node in a slot takes it. A push and a pop that meet this way cancel out
+ * without touching top at all, so the more contention, the more of it is
+ * absorbed by the side array. A push that nobody met withdraws its node and
+ * goes back to top.
+ */
+
+#define ELIM_SPINS 256
+
+typedef struct {
+    _Alignas(CACHE_LINE) Node *offer; // a waiting push's node, or NULL
+    long taken;                       // pops that were served from this slot
+} elim_slot_t;
+
+typedef struct {
+    lf_stack_t stack;
+    int num_slots;
+    elim_slot_t *slots;
+} elim_stack_t;
+
+int elim_stack_init(elim_stack_t *s, int max_threads);
+void elim_stack_destroy(elim_stack_t *s);
+
+void elim_push(elim_stack_t *s, Node *node);
+int elim_pop(elim_stack_t *s, hp_record_t *rec);
+
+/* push/pop pairs that met in the side array */
+long elim_stack_eliminated(const elim_stack_t *s);
+
+#endif
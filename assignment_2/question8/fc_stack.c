@@ -0,0 +1,133 @@
+#include "fc_stack.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static __thread long lock_retries; // lock grabs this thread lost to another combiner after seeing the lock free
+
+int fc_stack_init(fc_stack_t *s, int max_threads) {
+    s->lock = 0;
+    s->top = NULL;
+    s->passes = 0;
+    s->combined = 0;
+    s->num_records = max_threads;
+    s->records = (fc_record_t *)aligned_alloc(CACHE_LINE, max_threads * sizeof(fc_record_t));
+    if (s->records == NULL) {
+        perror("aligned_alloc failed for publication records");
+        return -1;
+    }
+    for (int r = 0; r < max_threads; r++) {
+        s->records[r].op = FC_NONE;
+        s->records[r].active = 0;
+    }
+    return 0;
+}
+
+void fc_stack_destroy(fc_stack_t *s) {
+    Node *current = s->top;
+    while (current != NULL) {
+        Node *next_node = current->next;
+        node_free(current);
+        current = next_node;
+    }
+    s->top = NULL;
+    free(s->records);
+    s->records = NULL;
+}
+
+fc_record_t *fc_acquire(fc_stack_t *s) {
+    for (int r = 0; r < s->num_records; r++) {
+        fc_record_t *rec = &s->records[r];
+        if (!__atomic_load_n(&rec->active, __ATOMIC_RELAXED) &&
+            __sync_bool_compare_and_swap(&rec->active, 0, 1)) {
+            return rec;
+        }
+    }
+    return NULL;
+}
+
+void fc_release(fc_stack_t *s, fc_record_t *rec) {
+    (void)s;
+    __atomic_store_n(&rec->active, 0, __ATOMIC_RELEASE);
+}
+
+static inline void finish(fc_record_t *rec, int result) {
+    rec->result = result;
+    __atomic_store_n(&rec->op, FC_NONE, __ATOMIC_RELEASE);
+}
+
+/* one pass over every record, lock held */
+static void combine(fc_stack_t *s) {
+    fc_record_t *waiting_push = NULL; // a push seen in this pass, not yet linked in
+    long served = 0;
+
+    for (int r = 0; r < s->num_records; r++) {
+        fc_record_t *rec = &s->records[r];
+        int op = __atomic_load_n(&rec->op, __ATOMIC_ACQUIRE);
+        if (op == FC_NONE) continue;
+        served++;
+
+        if (op == FC_PUSH) {
+            if (waiting_push != NULL) { // two pushes: the earlier one goes on the stack
+                waiting_push->node->next = s->top;
+                s->top = waiting_push->node;
+                finish(waiting_push, 0);
+            }
+            waiting_push = rec;
+        } else if (waiting_push != NULL) { // a pop meets a push: hand the node over directly
+            Node *node = waiting_push->node;
+            finish(waiting_push, 0);
+            finish(rec, node->node_id);
+            node_free(node);
+            waiting_push = NULL;
+        } else if (s->top != NULL) {
+            Node *node = s->top;
+            s->top = node->next;
+            finish(rec, node->node_id);
+            node_free(node);
+        } else {
+            finish(rec, -1);
+        }
+    }
+
+    if (waiting_push != NULL) {
+        waiting_push->node->next = s->top;
+        s->top = waiting_push->node;
+        finish(waiting_push, 0);
+    }
+    s->passes++;
+    s->combined += served;
+}
+
+/* publishes op and waits until some combiner, possibly this thread, has served it */
+static int fc_apply(fc_stack_t *s, fc_record_t *rec, int op) {
+    __atomic_store_n(&rec->op, op, __ATOMIC_RELEASE);
+    for (;;) {
+        if (__atomic_load_n(&rec->op, __ATOMIC_ACQUIRE) == FC_NONE) {
+            return rec->result;
+        }
+        if (__atomic_load_n(&s->lock, __ATOMIC_RELAXED) == 0) {
+            if (__atomic_exchange_n(&s->lock, 1, __ATOMIC_ACQUIRE) == 0) {
+                combine(s); // serves our own request too
+                __atomic_store_n(&s->lock, 0, __ATOMIC_RELEASE);
+                continue;
+            }
+            lock_retries++;
+        }
+        __builtin_ia32_pause();
+    }
+}
+
+long fc_take_retries(void) {
+    long retries = lock_retries;
+    lock_retries = 0;
+    return retries;
+}
+
+void fc_push(fc_stack_t *s, fc_record_t *rec, Node *node) {
+    rec->node = node;
+    fc_apply(s, rec, FC_PUSH);
+}
+
+int fc_pop(fc_stack_t *s, fc_record_t *rec) {
+    return fc_apply(s, rec, FC_POP);
+}
@@ -0,0 +1,55 @@
+#ifndef FC_STACK_H
+#define FC_STACK_H
+
+#include "node_pool.h"
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+/*
+ * Flat-combining stack (Hendler, Incze, Shavit, Tzafrir 2010).
+ *
+ * Each thread owns a publication record. To push or pop it writes the request
+ * into its record and spins on it; whichever thread gets the lock becomes the
+ * combiner, walks all records and applies every pending request to a plain
+ * sequential stack, matching a push with a pop directly when it sees both. The
+ * top of the stack and the lock only ever move between combiners, so under
+ * contention the cache line traffic is one record per operation instead of
+ * everyone fighting over top.
+ */
+
+enum fc_op { FC_NONE, FC_PUSH, FC_POP };
+
+typedef struct {
+    _Alignas(CACHE_LINE) int op;   // pending request, FC_NONE once served
+    int active;                    // claimed by a running thread
+    Node *node;                    // push: the node to link in
+    int result;                    // pop: the id, -1 if the stack was empty
+} fc_record_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) int lock;
+    Node *top;                     // only touched by the combiner
+    long passes;                   // combining passes, and requests they served
+    long combined;
+    int num_records;
+    fc_record_t *records;
+} fc_stack_t;
+
+int fc_stack_init(fc_stack_t *s, int max_threads);
+
+/* frees the nodes still on the stack */
+void fc_stack_destroy(fc_stack_t *s);
+
+/* claims a publication record for the calling thread, NULL if none is free */
+fc_record_t *fc_acquire(fc_stack_t *s);
+void fc_release(fc_stack_t *s, fc_record_t *rec);
+
+void fc_push(fc_stack_t *s, fc_record_t *rec, Node *node);
+int fc_pop(fc_stack_t *s, fc_record_t *rec);
+
+/* lock exchanges the calling thread lost since its last call */
+long fc_take_retries(void);
+
+#endif
@@ -0,0 +1,115 @@
+#include "hazard.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void release_node(hp_domain_t *dom, void *node) {
+    if (dom->free_fn != NULL) dom->free_fn(node, dom->free_arg);
+    else free(node);
+}
+
+int hp_init(hp_domain_t *dom, int max_threads, hp_free_fn free_fn, void *free_arg) {
+    dom->num_records = max_threads;
+    dom->threshold = 2 * max_threads + 16; // keeps the scan cost per retired node constant
+    dom->free_fn = free_fn;
+    dom->free_arg = free_arg;
+    dom->records = (hp_record_t *)aligned_alloc(CACHE_LINE, max_threads * sizeof(hp_record_t));
+    if (dom->records == NULL) {
+        perror("aligned_alloc failed for hazard records");
+        return -1;
+    }
+
+    for (int r = 0; r < max_threads; r++) {
+        hp_record_t *rec = &dom->records[r];
+        rec->hazard = NULL;
+        rec->active = 0;
+        rec->num_retired = 0;
+        rec->capacity = dom->threshold;
+        rec->freed = 0;
+        rec->retired = (void **)malloc(rec->capacity * sizeof(void *));
+        rec->scan = (void **)malloc(max_threads * sizeof(void *));
+        if (rec->retired == NULL || rec->scan == NULL) {
+            perror("malloc failed for hazard records");
+            for (int i = 0; i <= r; i++) {
+                free(dom->records[i].retired);
+                free(dom->records[i].scan);
+            }
+            free(dom->records);
+            dom->records = NULL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void hp_destroy(hp_domain_t *dom) {
+    for (int r = 0; r < dom->num_records; r++) {
+        hp_record_t *rec = &dom->records[r];
+        for (int i = 0; i < rec->num_retired; i++) {
+            release_node(dom, rec->retired[i]);
+        }
+        free(rec->retired);
+        free(rec->scan);
+    }
+    free(dom->records);
+    dom->records = NULL;
+}
+
+hp_record_t *hp_acquire(hp_domain_t *dom) {
+    for (int r = 0; r < dom->num_records; r++) {
+        hp_record_t *rec = &dom->records[r];
+        if (!__atomic_load_n(&rec->active, __ATOMIC_RELAXED) &&
+            __sync_bool_compare_and_swap(&rec->active, 0, 1)) {
+            return rec;
+        }
+    }
+    return NULL;
+}
+
+void hp_release(hp_domain_t *dom, hp_record_t *rec) {
+    (void)dom;
+    hp_clear(rec);
+    __atomic_store_n(&rec->active, 0, __ATOMIC_RELEASE);
+}
+
+/* frees the retired nodes no thread has published, keeps the rest */
+static void hp_scan(hp_domain_t *dom, hp_record_t *rec) {
+    int num_hazards = 0;
+    for (int r = 0; r < dom->num_records; r++) {
+        void *p = __atomic_load_n(&dom->records[r].hazard, __ATOMIC_SEQ_CST);
+        if (p != NULL) rec->scan[num_hazards++] = p;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < rec->num_retired; i++) {
+        void *node = rec->retired[i];
+        int protected = 0;
+        for (int h = 0; h < num_hazards; h++) { // a handful of threads, a linear search beats sorting
+            if (rec->scan[h] == node) protected = 1;
+        }
+        if (protected) {
+            rec->retired[kept++] = node;
+        } else {
+            release_node(dom, node);
+            rec->freed++;
+        }
+    }
+    rec->num_retired = kept;
+}
+
+void hp_retire(hp_domain_t *dom, hp_record_t *rec, void *node) {
+    if (rec->num_retired == rec->capacity) {
+        // at most num_records nodes survive a scan, so this only grows for inherited lists
+        int capacity = rec->capacity * 2;
+        void **grown = (void **)realloc(rec->retired, capacity * sizeof(void *));
+        if (grown == NULL) {
+            perror("realloc failed for retired list");
+            exit(1);
+        }
+        rec->retired = grown;
+        rec->capacity = capacity;
+    }
+    rec->retired[rec->num_retired++] = node;
+    if (rec->num_retired >= dom->threshold) {
+        hp_scan(dom, rec);
+    }
+}
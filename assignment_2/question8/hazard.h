@@ -0,0 +1,63 @@
+#ifndef HAZARD_H
+#define HAZARD_H
+
+#include <stddef.h>
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+/*
+ * Hazard pointers (Michael 2004), one hazard slot per thread.
+ *
+ * Before dereferencing a shared node a thread publishes its address in its
+ * slot and checks that the node is still reachable. A node taken out of the
+ * structure is retired rather than freed; once a thread has retired enough
+ * nodes it scans every slot and frees the retired nodes nobody has published.
+ * Nodes still protected stay on the list for the next scan.
+ */
+
+typedef void (*hp_free_fn)(void *node, void *arg);
+
+typedef struct {
+    _Alignas(CACHE_LINE) void *hazard; // the node this thread is about to dereference
+    int active;                        // claimed by a running thread
+    void **retired;
+    int num_retired;
+    int capacity;
+    void **scan;                       // hazards collected during a scan
+    long freed;
+} hp_record_t;
+
+typedef struct {
+    int num_records;
+    int threshold;       // scan once this many nodes are retired
+    hp_record_t *records;
+    hp_free_fn free_fn;
+    void *free_arg;
+} hp_domain_t;
+
+/* free_fn NULL means free() */
+int hp_init(hp_domain_t *dom, int max_threads, hp_free_fn free_fn, void *free_arg);
+
+/* frees every retired node; no thread may be using the domain */
+void hp_destroy(hp_domain_t *dom);
+
+/* claims a record for the calling thread, NULL if max_threads are active */
+hp_record_t *hp_acquire(hp_domain_t *dom);
+
+/* gives the record back; its retired nodes wait for the next owner's scans */
+void hp_release(hp_domain_t *dom, hp_record_t *rec);
+
+static inline void hp_protect(hp_record_t *rec, void *node) {
+    __atomic_store_n(&rec->hazard, node, __ATOMIC_SEQ_CST);
+}
+
+static inline void hp_clear(hp_record_t *rec) {
+    __atomic_store_n(&rec->hazard, NULL, __ATOMIC_RELEASE);
+}
+
+/* node is no longer reachable from the structure */
+void hp_retire(hp_domain_t *dom, hp_record_t *rec, void *node);
+
+#endif
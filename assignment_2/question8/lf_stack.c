@@ -0,0 +1,100 @@
+#include "lf_stack.h"
+#include "backoff.h"
+
+static __thread long cas_retries; // failed CAS attempts on top by this thread
+
+/*
+ * The two halves are loaded separately; a torn pair (pointer from one update,
+ * tag from another) can never match the current top, so the CAS that follows
+ * simply fails and the loop retries.
+ */
+static inline tagged_ptr_t load_top(lf_stack_t *s) {
+    tagged_ptr_t t;
+    t.tag = __atomic_load_n(&s->top.tag, __ATOMIC_ACQUIRE);
+    t.ptr = __atomic_load_n(&s->top.ptr, __ATOMIC_ACQUIRE);
+    return t;
+}
+
+static inline int cas_top(lf_stack_t *s, tagged_ptr_t old, Node *ptr) {
+    tagged_ptr_t new = {.ptr = ptr, .tag = old.tag + 1};
+    return __sync_bool_compare_and_swap(&s->top.raw, old.raw, new.raw);
+}
+
+/* reclaimed nodes go back to whichever allocator the program picked */
+static void free_node(void *node, void *arg) {
+    (void)arg;
+    node_free((Node *)node);
+}
+
+int lf_stack_init(lf_stack_t *s, int max_threads) {
+    s->top.ptr = NULL;
+    s->top.tag = 0;
+    s->backoff = 0;
+    return hp_init(&s->hp, max_threads, free_node, NULL);
+}
+
+void lf_stack_destroy(lf_stack_t *s) {
+    Node *current = s->top.ptr;
+    while (current != NULL) {
+        Node *next_node = current->next;
+        node_free(current);
+        current = next_node;
+    }
+    s->top.ptr = NULL;
+    hp_destroy(&s->hp);
+}
+
+int lf_try_push(lf_stack_t *s, Node *node) {
+    tagged_ptr_t old = load_top(s);
+    node->next = old.ptr;
+    if (cas_top(s, old, node)) return 1;
+    cas_retries++;
+    return 0;
+}
+
+int lf_try_pop(lf_stack_t *s, hp_record_t *rec, int *id) {
+    tagged_ptr_t old = load_top(s);
+    if (old.ptr == NULL) {
+        *id = -1;
+        return 1;
+    }
+
+    // publish, then make sure old was still on the stack after publishing:
+    // from then on no scan can free it under us
+    hp_protect(rec, old.ptr);
+    if (__atomic_load_n(&s->top.ptr, __ATOMIC_SEQ_CST) != old.ptr ||
+        !cas_top(s, old, old.ptr->next)) {
+        cas_retries++;
+        return 0;
+    }
+    hp_clear(rec);
+
+    *id = old.ptr->node_id;
+    hp_retire(&s->hp, rec, old.ptr);
+    return 1;
+}
+
+void lf_push(lf_stack_t *s, Node *node) {
+    backoff_t b;
+    backoff_init(&b);
+    while (!lf_try_push(s, node)) {
+        if (s->backoff) backoff_wait(&b);
+    }
+}
+
+long lf_take_retries(void) {
+    long retries = cas_retries;
+    cas_retries = 0;
+    return retries;
+}
+
+int lf_pop(lf_stack_t *s, hp_record_t *rec) {
+    backoff_t b;
+    backoff_init(&b);
+    int id;
+    while (!lf_try_pop(s, rec, &id)) {
+        if (s->backoff) backoff_wait(&b);
+    }
+    hp_clear(rec);
+    return id;
+}
@@ -0,0 +1,50 @@
+#ifndef LF_STACK_H
+#define LF_STACK_H
+
+#include <stdint.h>
+#include "hazard.h"
+#include "node_pool.h"
+
+/*
+ * Top of the stack as a pointer plus a tag that every successful CAS bumps,
+ * swapped as one 16-byte word with cmpxchg16b (build with -mcx16). A pop that
+ * read top = A, then lost the CPU while A was popped, freed, reused and pushed
+ * again sees a different tag and retries instead of installing a stale next.
+ */
+typedef union {
+    struct {
+        Node *ptr;
+        uintptr_t tag;
+    };
+    unsigned __int128 raw;
+} __attribute__((aligned(16))) tagged_ptr_t;
+
+/*
+ * Treiber stack. The tag takes care of ABA; hazard pointers take care of
+ * reading old->next from a node another thread has already popped: popped
+ * nodes are retired and only freed once no pop has them published.
+ */
+typedef struct {
+    tagged_ptr_t top;
+    hp_domain_t hp;
+    int backoff;         // back off exponentially after a failed CAS (see backoff.h)
+} lf_stack_t;
+
+int lf_stack_init(lf_stack_t *s, int max_threads);
+
+/* frees the nodes still on the stack and every retired one */
+void lf_stack_destroy(lf_stack_t *s);
+
+void lf_push(lf_stack_t *s, Node *node);
+
+/* returns the popped node's id, -1 if the stack was empty; the node is retired through rec */
+int lf_pop(lf_stack_t *s, hp_record_t *rec);
+
+/* single attempts, for variants that do something else when top is contended: 1 if done, 0 if the CAS lost */
+int lf_try_push(lf_stack_t *s, Node *node);
+int lf_try_pop(lf_stack_t *s, hp_record_t *rec, int *id);
+
+/* failed CAS attempts by the calling thread since its last call */
+long lf_take_retries(void);
+
+#endif
@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+#include "mpmc_queue.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static void futex_wait(int *addr, int expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(int *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+int mpmc_init(mpmc_queue_t *q, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+
+    size_t bytes = (size * sizeof(mpmc_cell_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    q->cells = (mpmc_cell_t *)aligned_alloc(CACHE_LINE, bytes);
+    if (q->cells == NULL) {
+        perror("aligned_alloc failed for queue cells");
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        q->cells[i].seq = i;
+    }
+    q->mask = size - 1;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    q->not_empty = 0;
+    q->empty_sleepers = 0;
+    q->not_full = 0;
+    q->full_sleepers = 0;
+    return 0;
+}
+
+void mpmc_destroy(mpmc_queue_t *q) {
+    free(q->cells);
+    q->cells = NULL;
+}
+
+/*
+ * Claims up to n consecutive tickets on *pos whose cells are in state
+ * seq == ticket + offset (offset 0: free for a producer, 1: full for a
+ * consumer). A cell in that state keeps it until the ticket's owner acts, so
+ * what was seen before the CAS still holds after it. Returns the first ticket
+ * and the count in *got, 0 if the first cell is not ready.
+ */
+static size_t claim(mpmc_queue_t *q, size_t *pos, size_t offset, size_t n, size_t *got) {
+    size_t ticket = __atomic_load_n(pos, __ATOMIC_RELAXED);
+    for (;;) {
+        size_t k = 0;
+        while (k < n) {
+            size_t seq = __atomic_load_n(&q->cells[(ticket + k) & q->mask].seq, __ATOMIC_ACQUIRE);
+            if (seq != ticket + k + offset) break;
+            k++;
+        }
+        if (k == 0) {
+            // behind: another thread took this ticket, reload; otherwise the ring is full / empty
+            size_t seq = __atomic_load_n(&q->cells[ticket & q->mask].seq, __ATOMIC_ACQUIRE);
+            if ((long)(seq - (ticket + offset)) < 0) {
+                *got = 0;
+                return 0;
+            }
+            ticket = __atomic_load_n(pos, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(pos, &ticket, ticket + k, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            *got = k;
+            return ticket;
+        }
+        // a failed CAS left the current value in ticket
+    }
+}
+
+size_t mpmc_try_enqueue_batch(mpmc_queue_t *q, void *const *data, size_t n) {
+    size_t got;
+    size_t ticket = claim(q, &q->enqueue_pos, 0, n, &got);
+    for (size_t i = 0; i < got; i++) {
+        mpmc_cell_t *cell = &q->cells[(ticket + i) & q->mask];
+        cell->data = data[i];
+        __atomic_store_n(&cell->seq, ticket + i + 1, __ATOMIC_RELEASE);
+    }
+    return got;
+}
+
+size_t mpmc_try_dequeue_batch(mpmc_queue_t *q, void **data, size_t n) {
+    size_t got;
+    size_t ticket = claim(q, &q->dequeue_pos, 1, n, &got);
+    for (size_t i = 0; i < got; i++) {
+        mpmc_cell_t *cell = &q->cells[(ticket + i) & q->mask];
+        data[i] = cell->data;
+        __atomic_store_n(&cell->seq, ticket + i + q->mask + 1, __ATOMIC_RELEASE);
+    }
+    return got;
+}
+
+int mpmc_try_enqueue(mpmc_queue_t *q, void *data) {
+    return mpmc_try_enqueue_batch(q, &data, 1) == 1;
+}
+
+int mpmc_try_dequeue(mpmc_queue_t *q, void **data) {
+    return mpmc_try_dequeue_batch(q, data, 1) == 1;
+}
+
+/*
+ * Wakes sleepers on word after this thread changed the queue. The fence pairs
+ * with the one in sleep_on(): either the sleeper's retry sees our change or we
+ * see its flag, so a wake-up cannot be lost. Clearing the flag means only the
+ * first change after someone went to sleep pays for the syscall; sleepers that
+ * find nothing set it again.
+ */
+static void wake(int *word, int *sleepers) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(sleepers, __ATOMIC_RELAXED) && __atomic_exchange_n(sleepers, 0, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(word, 1, __ATOMIC_RELEASE);
+        futex_wake(word, INT_MAX);
+    }
+}
+
+/* flags a sleeper, retries once, then waits for the word to move */
+static size_t sleep_on(int *word, int *sleepers, size_t (*retry)(mpmc_queue_t *, void *, size_t),
+                       mpmc_queue_t *q, void *data, size_t n) {
+    int seen = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sleepers, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    size_t got = retry(q, data, n);
+    if (got == 0) futex_wait(word, seen);
+    return got;
+}
+
+static size_t retry_enqueue(mpmc_queue_t *q, void *data, size_t n) {
+    return mpmc_try_enqueue_batch(q, (void *const *)data, n);
+}
+
+static size_t retry_dequeue(mpmc_queue_t *q, void *data, size_t n) {
+    return mpmc_try_dequeue_batch(q, (void **)data, n);
+}
+
+void mpmc_enqueue_batch(mpmc_queue_t *q, void *const *data, size_t n) {
+    size_t done = 0;
+    int spins = 0;
+    while (done < n) {
+        size_t got = mpmc_try_enqueue_batch(q, data + done, n - done);
+        if (got == 0 && ++spins > MPMC_SPINS) {
+            got = sleep_on(&q->not_full, &q->full_sleepers, retry_enqueue, q, (void *)(data + done), n - done);
+            spins = 0;
+        }
+        if (got > 0) {
+            done += got;
+            wake(&q->not_empty, &q->empty_sleepers);
+        } else {
+            __builtin_ia32_pause();
+        }
+    }
+}
+
+size_t mpmc_dequeue_batch(mpmc_queue_t *q, void **data, size_t n) {
+    int spins = 0;
+    for (;;) {
+        size_t got = mpmc_try_dequeue_batch(q, data, n);
+        if (got == 0 && ++spins > MPMC_SPINS) {
+            got = sleep_on(&q->not_empty, &q->empty_sleepers, retry_dequeue, q, (void *)data, n);
+            spins = 0;
+        }
+        if (got > 0) {
+            wake(&q->not_full, &q->full_sleepers);
+            return got;
+        }
+        __builtin_ia32_pause();
+    }
+}
+
+void mpmc_enqueue(mpmc_queue_t *q, void *data) {
+    mpmc_enqueue_batch(q, &data, 1);
+}
+
+void *mpmc_dequeue(mpmc_queue_t *q) {
+    void *data;
+    mpmc_dequeue_batch(q, &data, 1);
+    return data;
+}
@@ -0,0 +1,62 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <stddef.h>
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+/*
+ * Bounded lock-free multi-producer/multi-consumer FIFO (Vyukov).
+ *
+ * The ring has a power-of-two number of cells, each with a sequence number.
+ * Cell i starts with seq = i. A producer holding ticket t may fill cell
+ * t & mask once its seq equals t, and publishes it with seq = t + 1; a
+ * consumer holding ticket t may empty it once seq equals t + 1, and hands it
+ * back to the producer of ticket t + capacity with seq = t + capacity. Tickets
+ * come from CAS on the padded enqueue/dequeue counters, so producers and
+ * consumers never write the same line except the cell they hand over.
+ *
+ * The blocking calls spin briefly and then sleep on a futex; the other side
+ * only makes a wake-up syscall when someone went to sleep since the last one.
+ */
+
+#define MPMC_SPINS 128 // tries before a blocking call goes to sleep
+
+typedef struct {
+    size_t seq;
+    void *data;
+} mpmc_cell_t;
+
+typedef struct {
+    mpmc_cell_t *cells;
+    size_t mask;
+    _Alignas(CACHE_LINE) size_t enqueue_pos;
+    _Alignas(CACHE_LINE) size_t dequeue_pos;
+    _Alignas(CACHE_LINE) int not_empty;    // futex word, bumped when an item arrives and consumers sleep
+    int empty_sleepers;                    // set by a consumer going to sleep, cleared by the wake
+    _Alignas(CACHE_LINE) int not_full;     // futex word, bumped when a cell frees up and producers sleep
+    int full_sleepers;
+} mpmc_queue_t;
+
+/* capacity is rounded up to a power of two */
+int mpmc_init(mpmc_queue_t *q, size_t capacity);
+void mpmc_destroy(mpmc_queue_t *q);
+
+/* non-blocking: 1 on success, 0 if the queue was full / empty */
+int mpmc_try_enqueue(mpmc_queue_t *q, void *data);
+int mpmc_try_dequeue(mpmc_queue_t *q, void **data);
+
+/* up to n items in one ticket claim; returns how many went through, 0 if full / empty */
+size_t mpmc_try_enqueue_batch(mpmc_queue_t *q, void *const *data, size_t n);
+size_t mpmc_try_dequeue_batch(mpmc_queue_t *q, void **data, size_t n);
+
+/* blocking versions; the batch calls return once all n items went through */
+void mpmc_enqueue(mpmc_queue_t *q, void *data);
+void *mpmc_dequeue(mpmc_queue_t *q);
+void mpmc_enqueue_batch(mpmc_queue_t *q, void *const *data, size_t n);
+/* waits for at least one item, returns how many it took (at most n) */
+size_t mpmc_dequeue_batch(mpmc_queue_t *q, void **data, size_t n);
+
+#endif
@@ -0,0 +1,63 @@
+#include "mutex_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int mutex_queue_init(mutex_queue_t *q, size_t capacity) {
+    q->items = (void **)malloc(capacity * sizeof(void *));
+    if (q->items == NULL) {
+        perror("malloc failed for queue items");
+        return -1;
+    }
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return 0;
+}
+
+void mutex_queue_destroy(mutex_queue_t *q) {
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->items);
+    q->items = NULL;
+}
+
+void mutex_enqueue_batch(mutex_queue_t *q, void *const *data, size_t n) {
+    size_t done = 0;
+    pthread_mutex_lock(&q->lock);
+    while (done < n) {
+        while (q->count == q->capacity) {
+            pthread_cond_wait(&q->not_full, &q->lock);
+        }
+        size_t room = q->capacity - q->count;
+        size_t k = n - done < room ? n - done : room;
+        for (size_t i = 0; i < k; i++) {
+            q->items[(q->head + q->count + i) % q->capacity] = data[done + i];
+        }
+        q->count += k;
+        done += k;
+        if (k == 1) pthread_cond_signal(&q->not_empty);
+        else pthread_cond_broadcast(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+size_t mutex_dequeue_batch(mutex_queue_t *q, void **data, size_t n) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    size_t k = n < q->count ? n : q->count;
+    for (size_t i = 0; i < k; i++) {
+        data[i] = q->items[(q->head + i) % q->capacity];
+    }
+    q->head = (q->head + k) % q->capacity;
+    q->count -= k;
+    if (k == 1) pthread_cond_signal(&q->not_full);
+    else pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return k;
+}
@@ -0,0 +1,30 @@
+#ifndef MUTEX_QUEUE_H
+#define MUTEX_QUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * The textbook bounded queue, for comparison with mpmc_queue: a ring buffer
+ * behind one mutex, with condition variables for not-empty and not-full. The
+ * batch calls move as many items as fit under a single lock acquisition.
+ */
+
+typedef struct {
+    void **items;
+    size_t capacity;
+    size_t head;    // next item to dequeue
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} mutex_queue_t;
+
+int mutex_queue_init(mutex_queue_t *q, size_t capacity);
+void mutex_queue_destroy(mutex_queue_t *q);
+
+/* blocking; enqueue returns once all n items are in, dequeue once it has at least one */
+void mutex_enqueue_batch(mutex_queue_t *q, void *const *data, size_t n);
+size_t mutex_dequeue_batch(mutex_queue_t *q, void **data, size_t n);
+
+#endif
@@ -0,0 +1,133 @@
+#include "node_pool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    Node *head;    // free nodes linked through next
+    int count;
+} node_cache_t;
+
+static enum node_alloc_mode alloc_mode = NODE_MALLOC;
+static __thread node_cache_t cache;
+
+/* global pool: batches of free nodes (NODE_BATCH except those left by exiting threads) and the slabs they were cut from */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static node_cache_t *batches;
+static int num_batches, batch_capacity;
+static void **slabs;
+static int num_slabs, slab_capacity;
+static long lock_count;
+
+static void *grow(void *array, int *capacity, size_t elem) {
+    *capacity = *capacity == 0 ? 64 : *capacity * 2;
+    void *grown = realloc(array, *capacity * elem);
+    if (grown == NULL) {
+        perror("realloc failed for node pool");
+        exit(1);
+    }
+    return grown;
+}
+
+/* cuts a fresh slab into batches; pool_lock held */
+static void add_slab(void) {
+    Node *slab = (Node *)malloc(NODE_SLAB * sizeof(Node));
+    if (slab == NULL) {
+        perror("malloc failed for node slab");
+        exit(1);
+    }
+    if (num_slabs == slab_capacity) slabs = grow(slabs, &slab_capacity, sizeof(void *));
+    slabs[num_slabs++] = slab;
+
+    for (int b = 0; b < NODE_SLAB / NODE_BATCH; b++) {
+        Node *first = slab + b * NODE_BATCH;
+        for (int i = 0; i < NODE_BATCH - 1; i++) {
+            first[i].next = &first[i + 1];
+        }
+        first[NODE_BATCH - 1].next = NULL;
+        if (num_batches == batch_capacity) batches = grow(batches, &batch_capacity, sizeof(node_cache_t));
+        batches[num_batches++] = (node_cache_t){first, NODE_BATCH};
+    }
+}
+
+static void refill(void) {
+    pthread_mutex_lock(&pool_lock);
+    lock_count++;
+    if (num_batches == 0) add_slab();
+    cache = batches[--num_batches];
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/* hands the first count cached nodes back as one batch */
+static void spill(int count) {
+    Node *first = cache.head, *last = cache.head;
+    for (int i = 1; i < count; i++) {
+        last = last->next;
+    }
+    cache.head = last->next;
+    cache.count -= count;
+    last->next = NULL;
+
+    pthread_mutex_lock(&pool_lock);
+    lock_count++;
+    if (num_batches == batch_capacity) batches = grow(batches, &batch_capacity, sizeof(node_cache_t));
+    batches[num_batches++] = (node_cache_t){first, count};
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void node_pool_init(enum node_alloc_mode mode) {
+    alloc_mode = mode;
+}
+
+void node_pool_destroy(void) {
+    for (int s = 0; s < num_slabs; s++) {
+        free(slabs[s]);
+    }
+    free(slabs);
+    free(batches);
+    slabs = NULL;
+    batches = NULL;
+    num_slabs = slab_capacity = num_batches = batch_capacity = 0;
+    cache.head = NULL;
+    cache.count = 0;
+}
+
+const char *node_pool_name(void) {
+    return alloc_mode == NODE_POOL ? "pool" : "malloc";
+}
+
+Node *node_alloc(void) {
+    if (alloc_mode == NODE_MALLOC) return (Node *)malloc(sizeof(Node));
+
+    if (cache.count == 0) refill();
+    Node *node = cache.head;
+    cache.head = node->next;
+    cache.count--;
+    return node;
+}
+
+void node_free(Node *node) {
+    if (alloc_mode == NODE_MALLOC) {
+        free(node);
+        return;
+    }
+
+    node->next = cache.head;
+    cache.head = node;
+    if (++cache.count == 2 * NODE_BATCH) spill(NODE_BATCH);
+}
+
+void node_pool_thread_exit(void) {
+    if (alloc_mode == NODE_MALLOC) return;
+    // partial batches go back too, with their size
+    while (cache.count > 0) {
+        spill(cache.count < NODE_BATCH ? cache.count : NODE_BATCH);
+    }
+}
+
+void node_pool_stats(long *num_slabs_out, long *refills) {
+    pthread_mutex_lock(&pool_lock);
+    *num_slabs_out = num_slabs;
+    *refills = lock_count;
+    pthread_mutex_unlock(&pool_lock);
+}
@@ -0,0 +1,41 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+typedef struct node {
+    int node_id;
+    struct node *next;
+} Node;
+
+/*
+ * Node allocator for the stacks, picked at runtime.
+ *
+ * NODE_MALLOC is plain malloc/free. NODE_POOL carves nodes out of slabs and
+ * keeps a free list per thread; a thread that runs dry takes a whole batch of
+ * NODE_BATCH nodes from the global pool, and one that holds more than two
+ * batches hands one back, so the global lock is taken once per NODE_BATCH
+ * operations at most and a push/pop costs a couple of thread-local loads.
+ * Nodes may be freed by another thread than the one that allocated them.
+ */
+
+#define NODE_BATCH 64
+#define NODE_SLAB (64 * NODE_BATCH) // nodes per malloc'd slab
+
+enum node_alloc_mode { NODE_MALLOC, NODE_POOL };
+
+void node_pool_init(enum node_alloc_mode mode);
+
+/* frees every slab; all nodes become invalid */
+void node_pool_destroy(void);
+
+const char *node_pool_name(void);
+
+Node *node_alloc(void);
+void node_free(Node *node);
+
+/* returns the calling thread's cached nodes to the global pool; call before the thread exits */
+void node_pool_thread_exit(void);
+
+/* slabs allocated and global pool lock acquisitions so far */
+void node_pool_stats(long *slabs, long *refills);
+
+#endif
@@ -3,20 +3,33 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h> 
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <x86intrin.h>
+#include "lf_stack.h"
+#include "elim_stack.h"
+#include "fc_stack.h"
 
 int num_threads = 0;
 pthread_mutex_t stack_lock = PTHREAD_MUTEX_INITIALIZER;
 int node_counter = 0;
 
-typedef struct node {
-    int node_id;
-    struct node *next;
-} Node;
+Node *top = NULL; /* the mutex stack */
+lf_stack_t cas_stack; /* the lock-free stack: tagged top + hazard pointers */
+elim_stack_t elim_stack; /* the lock-free stack with an elimination array in front */
+fc_stack_t fc_stack; /* flat combining */
+static __thread hp_record_t *my_hp; /* this thread's hazard pointer, claimed for the CAS and elimination runs */
+static __thread fc_record_t *my_fc; /* this thread's flat-combining publication record */
 
-Node *top = NULL; 
+long stress_pairs = 0; /* --stress: push/pop pairs per thread */
+int private_ids = 0; /* --bench: ids come from a per-thread counter, not the shared node_counter */
+static __thread int private_id;
+int *seen; /* how many times each node id came off the stack */
+long empty_pops = 0;
 
-void print_remaining_nodes() {
-    Node *current = top;
+void print_remaining_nodes(Node *current) {
     if (current == NULL) {
         printf("Stack is empty.\n");
         return;
@@ -32,7 +45,7 @@ void cleanup_stack() {
     Node *next_node;
     while (current != NULL) {
         next_node = current->next;
-        free(current);
+        node_free(current);
         current = next_node;
     }
     top = NULL; 
@@ -42,7 +55,7 @@ void push_mutex() {
     Node *old_node;
     Node *new_node;
 
-    new_node = malloc(sizeof(Node));
+    new_node = node_alloc();
     if (new_node == NULL) {
         perror("malloc failed");
         return;
@@ -71,7 +84,7 @@ int pop_mutex() {
     if (old_node != NULL) {
         top = old_node->next;
         id = old_node->node_id;
-        free(old_node);
+        node_free(old_node);
     }
 
     pthread_mutex_unlock(&stack_lock);
@@ -80,124 +93,463 @@ int pop_mutex() {
 }
 
 
-void push_cas() {
-    Node *old_node;
-    Node *new_node;
-    new_node = malloc(sizeof(Node));
-
+/*
+ * a node with a fresh id, for the variants that do not hold a lock while pushing;
+ * the benchmark skips the shared counter, which would otherwise be the most
+ * contended cache line in the run
+ */
+static Node *make_node(void) {
+    Node *new_node = node_alloc();
     if (new_node == NULL) {
         perror("malloc failed");
-        return;
+        exit(1);
     }
+    new_node->node_id = private_ids ? private_id++ : __sync_fetch_and_add(&node_counter, 1);
+    return new_node;
+}
 
-   
-    new_node->node_id = __sync_fetch_and_add(&node_counter, 1);
-
-    do {
-        old_node = top;
-        new_node->next = old_node;
-        
-    } while (!__sync_bool_compare_and_swap(&top, old_node, new_node));
+void push_cas() {
+    lf_push(&cas_stack, make_node());
 }
 
+/* the node comes back through the hazard pointer domain, not free(): another pop may still be reading it */
 int pop_cas() {
-    Node *old_node;
-    Node *new_node;
-    int id = -1;
+    return lf_pop(&cas_stack, my_hp);
+}
 
-    while (1) {
-        old_node = top;
-        
-       
-        if (old_node == NULL) {
-            return -1; 
-        }
+void push_elim() {
+    elim_push(&elim_stack, make_node());
+}
 
-        new_node = old_node->next;
+int pop_elim() {
+    return elim_pop(&elim_stack, my_hp);
+}
 
-        
-        if (__sync_bool_compare_and_swap(&top, old_node, new_node)) {
-            id = old_node->node_id;
-            free(old_node); 
-            return id;
-        }
+void push_fc() {
+    fc_push(&fc_stack, my_fc, make_node());
+}
+
+int pop_fc() {
+    return fc_pop(&fc_stack, my_fc);
+}
+
+static void no_thread_state(void) {}
+static void cas_thread_begin(void) { my_hp = hp_acquire(&cas_stack.hp); }
+static void cas_thread_end(void) { hp_release(&cas_stack.hp, my_hp); }
+static void elim_thread_begin(void) { my_hp = hp_acquire(&elim_stack.stack.hp); }
+static void elim_thread_end(void) { hp_release(&elim_stack.stack.hp, my_hp); }
+static void fc_thread_begin(void) { my_fc = fc_acquire(&fc_stack); }
+static void fc_thread_end(void) { fc_release(&fc_stack, my_fc); }
+
+static Node *mutex_remaining(void) { return top; }
+static Node *cas_remaining(void) { return cas_stack.top.ptr; }
+static Node *elim_remaining(void) { return elim_stack.stack.top.ptr; }
+static Node *fc_remaining(void) { return fc_stack.top; }
+
+static long hazard_freed(const hp_domain_t *hp) {
+    long freed = 0;
+    for (int r = 0; r < hp->num_records; r++) {
+        freed += hp->records[r].freed;
     }
+    return freed;
 }
 
+static long no_retries(void) { return 0; }
+
+static void no_report(const char *name) { (void)name; }
+
+static void cas_report(const char *name) {
+    printf("%s: %ld nodes reclaimed by hazard pointer scans during the run\n", name, hazard_freed(&cas_stack.hp));
+}
+
+static void elim_report(const char *name) {
+    printf("%s: %ld push/pop pairs eliminated in %d slots, %ld nodes reclaimed by hazard pointer scans\n",
+           name, elim_stack_eliminated(&elim_stack), elim_stack.num_slots, hazard_freed(&elim_stack.stack.hp));
+}
+
+static void fc_report(const char *name) {
+    printf("%s: %ld combining passes, %.2f requests served per pass\n", name, fc_stack.passes,
+           fc_stack.passes > 0 ? (double)fc_stack.combined / fc_stack.passes : 0.0);
+}
+
+/* every variant behind the same push/pop interface; thread_begin/end claim per-thread state */
+typedef struct {
+    const char *option;
+    const char *name;
+    void (*thread_begin)(void);
+    void (*thread_end)(void);
+    void (*push)(void);
+    int (*pop)(void);
+    Node *(*remaining)(void);
+    void (*report)(const char *name);
+    long (*take_retries)(void); /* the calling thread's failed CAS or lock attempts since the last call */
+} stack_ops_t;
+
+static const stack_ops_t variants[] = {
+    {"mutex", "Mutex", no_thread_state, no_thread_state, push_mutex, pop_mutex, mutex_remaining, no_report, no_retries},
+    {"cas", "CAS", cas_thread_begin, cas_thread_end, push_cas, pop_cas, cas_remaining, cas_report, lf_take_retries},
+    {"elim", "Elimination", elim_thread_begin, elim_thread_end, push_elim, pop_elim, elim_remaining, elim_report, lf_take_retries},
+    {"fc", "Flat combining", fc_thread_begin, fc_thread_end, push_fc, pop_fc, fc_remaining, fc_report, fc_take_retries},
+};
+#define NUM_VARIANTS (int)(sizeof(variants) / sizeof(variants[0]))
+
 
 void *thread_func(void *arg) {
   
-    int opt = (int)(intptr_t)arg;
+    const stack_ops_t *ops = (const stack_ops_t *)arg;
     
 
-    if (opt == 0) {
-        push_mutex();
-        push_mutex();
-        pop_mutex();
-        pop_mutex();
-        push_mutex();
-    } else {
-        push_cas();
-        push_cas();
-        pop_cas();
-        pop_cas();
-        push_cas();
+    ops->thread_begin();
+    ops->push();
+    ops->push();
+    ops->pop();
+    ops->pop();
+    ops->push();
+    ops->thread_end();
+
+    node_pool_thread_exit(); // cached nodes go back to the global pool
+    pthread_exit(NULL);
+}
+
+/* stress run: every thread pushes a fresh id and pops one, stress_pairs times */
+void *stress_func(void *arg) {
+    const stack_ops_t *ops = (const stack_ops_t *)arg;
+    ops->thread_begin();
+
+    for (long i = 0; i < stress_pairs; i++) {
+        ops->push();
+        int id = ops->pop();
+        if (id < 0) __atomic_fetch_add(&empty_pops, 1, __ATOMIC_RELAXED);
+        else __atomic_fetch_add(&seen[id], 1, __ATOMIC_RELAXED);
     }
 
+    ops->thread_end();
+    node_pool_thread_exit();
     pthread_exit(NULL);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <num_threads>\n", argv[0]);
-        return 1;
+/*
+ * Runs the stress threads for one variant and checks that every id pushed came
+ * out exactly once, either from a pop or from what is left on the stack.
+ */
+int run_stress(pthread_t *workers, const stack_ops_t *ops) {
+    const char *name = ops->name;
+    long total = (long)num_threads * stress_pairs;
+    node_counter = 0;
+    empty_pops = 0;
+    memset(seen, 0, total * sizeof(int));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&workers[i], NULL, stress_func, (void *)ops);
     }
-    
-    num_threads = atoi(argv[1]);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
 
-    pthread_t *workers = malloc(sizeof(pthread_t) * num_threads);
-    if (workers == NULL) {
-        perror("malloc failed for workers");
+    for (Node *current = ops->remaining(); current != NULL; current = current->next) {
+        seen[current->node_id]++;
+    }
+    long lost = 0, duplicated = 0;
+    for (long id = 0; id < total; id++) {
+        if (seen[id] == 0) lost++;
+        else if (seen[id] > 1) duplicated++;
+    }
+
+    printf("%s: %ld push/pop pairs on %d threads in %.3f s (%.2f Mops/s, %s nodes)\n",
+           name, total, num_threads, secs, 2.0 * total / secs / 1e6, node_pool_name());
+    printf("%s: lost %ld, duplicated %ld, empty pops %ld\n", name, lost, duplicated, empty_pops);
+    ops->report(name);
+    long slabs, refills;
+    node_pool_stats(&slabs, &refills);
+    if (slabs > 0) {
+        printf("%s: node pool holds %ld slabs, global pool locked %ld times so far\n", name, slabs, refills);
+    }
+    return lost == 0 && duplicated == 0 ? 0 : 1;
+}
+
+/* ---------------- throughput benchmark ---------------- */
+
+#define LATENCY_SAMPLE_EVERY 64   /* time one operation in 64 */
+#define MAX_LATENCY_SAMPLES 65536 /* per thread; later samples overwrite the oldest */
+
+double bench_secs = 1.0; /* --duration */
+int push_pct = 50;       /* --push-ratio: percentage of operations that are pushes */
+long prefill = 1000;     /* --prefill: nodes pushed before the clock starts */
+
+typedef struct {
+    _Alignas(CACHE_LINE) const stack_ops_t *ops;
+    long ops_done;
+    long empty_pops;
+    long retries;
+    unsigned long long *samples; /* rdtsc cycles of sampled operations */
+    long num_samples;
+} bench_thread_t;
+
+static pthread_barrier_t bench_start;
+static int bench_stop;
+
+void *bench_func(void *arg) {
+    bench_thread_t *me = (bench_thread_t *)arg;
+    const stack_ops_t *ops = me->ops;
+    unsigned rng = (unsigned)(uintptr_t)me | 1;
+    long done = 0, empty = 0;
+
+    ops->thread_begin();
+    ops->take_retries(); // start from zero
+    pthread_barrier_wait(&bench_start);
+
+    while (!__atomic_load_n(&bench_stop, __ATOMIC_RELAXED)) {
+        rng ^= rng << 13; // xorshift32
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int push = rng % 100 < (unsigned)push_pct;
+
+        if (done % LATENCY_SAMPLE_EVERY == 0) {
+            unsigned aux;
+            _mm_lfence();
+            unsigned long long t0 = __rdtsc();
+            if (push) ops->push();
+            else if (ops->pop() < 0) empty++;
+            unsigned long long t1 = __rdtscp(&aux);
+            me->samples[me->num_samples++ % MAX_LATENCY_SAMPLES] = t1 - t0;
+        } else if (push) {
+            ops->push();
+        } else if (ops->pop() < 0) {
+            empty++;
+        }
+        done++;
+    }
+
+    me->ops_done = done;
+    me->empty_pops = empty;
+    me->retries = ops->take_retries();
+    ops->thread_end();
+    node_pool_thread_exit();
+    pthread_exit(NULL);
+}
+
+static int cmp_cycles(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* TSC ticks per nanosecond, measured against CLOCK_MONOTONIC */
+static double tsc_per_ns(void) {
+    struct timespec t0, t1, pause = {0, 50 * 1000 * 1000};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    unsigned long long c0 = __rdtsc();
+    nanosleep(&pause, NULL);
+    unsigned long long c1 = __rdtsc();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    return (c1 - c0) / ns;
+}
+
+/* runs one variant for bench_secs and prints one CSV row */
+int run_bench(pthread_t *workers, const stack_ops_t *ops, double ticks_per_ns) {
+    bench_thread_t *threads = (bench_thread_t *)aligned_alloc(CACHE_LINE, num_threads * sizeof(bench_thread_t));
+    if (threads == NULL) {
+        perror("aligned_alloc failed for bench threads");
         return 1;
     }
 
-  
-    printf("--- Testing Mutex ---\n");
-    node_counter = 0; 
-    
+    ops->thread_begin();
+    for (long i = 0; i < prefill; i++) {
+        ops->push();
+    }
+    ops->thread_end();
+
+    bench_stop = 0;
+    pthread_barrier_init(&bench_start, NULL, num_threads + 1);
     for (int i = 0; i < num_threads; i++) {
-        pthread_attr_t attr;
-        pthread_attr_init(&attr);
-       
-        pthread_create(&workers[i], &attr, thread_func, (void *)(intptr_t)0);
+        threads[i].ops = ops;
+        threads[i].num_samples = 0;
+        threads[i].samples = (unsigned long long *)malloc(MAX_LATENCY_SAMPLES * sizeof(unsigned long long));
+        if (threads[i].samples == NULL) {
+            perror("malloc failed for latency samples");
+            return 1;
+        }
+        pthread_create(&workers[i], NULL, bench_func, &threads[i]);
     }
 
+    struct timespec start, end, length;
+    length.tv_sec = (time_t)bench_secs;
+    length.tv_nsec = (long)((bench_secs - length.tv_sec) * 1e9);
+    pthread_barrier_wait(&bench_start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    nanosleep(&length, NULL);
+    __atomic_store_n(&bench_stop, 1, __ATOMIC_RELAXED);
     for (int i = 0; i < num_threads; i++) {
         pthread_join(workers[i], NULL);
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    pthread_barrier_destroy(&bench_start);
 
-    printf("Mutex: Remaining nodes \n");
-    print_remaining_nodes();
+    long total_ops = 0, empty = 0, retries = 0, num_samples = 0;
+    for (int i = 0; i < num_threads; i++) {
+        total_ops += threads[i].ops_done;
+        empty += threads[i].empty_pops;
+        retries += threads[i].retries;
+        num_samples += threads[i].num_samples < MAX_LATENCY_SAMPLES ? threads[i].num_samples : MAX_LATENCY_SAMPLES;
+    }
+    unsigned long long *all = (unsigned long long *)malloc((num_samples + 1) * sizeof(unsigned long long));
+    long n = 0;
+    for (int i = 0; i < num_threads && all != NULL; i++) {
+        long kept = threads[i].num_samples < MAX_LATENCY_SAMPLES ? threads[i].num_samples : MAX_LATENCY_SAMPLES;
+        for (long k = 0; k < kept; k++) {
+            all[n++] = threads[i].samples[k];
+        }
+        free(threads[i].samples);
+    }
+    double p50 = 0.0, p99 = 0.0;
+    if (n > 0) {
+        qsort(all, n, sizeof(unsigned long long), cmp_cycles);
+        p50 = all[n / 2] / ticks_per_ns;
+        p99 = all[n * 99 / 100] / ticks_per_ns;
+    }
+    free(all);
+    free(threads);
+
+    printf("%s,%s,%s,%d,%.3f,%d,%ld,%ld,%.3f,%.1f,%.1f,%ld,%.4f,%ld\n", ops->option, node_pool_name(),
+           strcmp(ops->option, "cas") == 0 && cas_stack.backoff ? "yes" : "no", num_threads, secs, push_pct,
+           prefill, total_ops, total_ops / secs / 1e6, p50, p99, retries,
+           total_ops > 0 ? (double)retries / total_ops : 0.0, empty);
+    fflush(stdout);
+    return 0;
+}
+
+static void destroy_stacks(void) {
     cleanup_stack();
+    lf_stack_destroy(&cas_stack);
+    elim_stack_destroy(&elim_stack);
+    fc_stack_destroy(&fc_stack);
+    node_pool_destroy();
+}
 
-   
-    printf("\n--- Testing CAS ---\n");
-    node_counter = 0;
+#define USAGE "Usage: %s [--alloc malloc|pool] [--stack mutex|cas|elim|fc|all] [--backoff] [--stress pairs] <num_threads>\n" \
+              "       %s [--alloc malloc|pool] [--stack ...] [--backoff] --bench [--duration secs] [--push-ratio pct] [--prefill nodes] <num_threads>\n"
 
-    for (int i = 0; i < num_threads; i++) {
-        pthread_attr_t attr;
-        pthread_attr_init(&attr);
-        
-        pthread_create(&workers[i], &attr, thread_func, (void *)(intptr_t)1);
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"stress", required_argument, NULL, 's'}, /* push/pop pairs per thread, checked for lost or duplicated nodes */
+        {"alloc", required_argument, NULL, 'a'},  /* node allocator: malloc (default) or pool */
+        {"stack", required_argument, NULL, 'v'},  /* run one variant only */
+        {"backoff", no_argument, NULL, 'b'},      /* exponential backoff after a failed CAS in the CAS stack */
+        {"bench", no_argument, NULL, 'B'},        /* fixed-time throughput run per variant, CSV out */
+        {"duration", required_argument, NULL, 'd'},
+        {"push-ratio", required_argument, NULL, 'r'},
+        {"prefill", required_argument, NULL, 'f'},
+        {NULL, 0, NULL, 0}
+    };
+    enum node_alloc_mode alloc_mode = NODE_MALLOC;
+    const char *only = "all";
+    int backoff = 0;
+    int bench = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 's') stress_pairs = atol(optarg);
+        else if (opt == 'a' && strcmp(optarg, "malloc") == 0) alloc_mode = NODE_MALLOC;
+        else if (opt == 'a' && strcmp(optarg, "pool") == 0) alloc_mode = NODE_POOL;
+        else if (opt == 'v') only = optarg;
+        else if (opt == 'b') backoff = 1;
+        else if (opt == 'B') bench = 1;
+        else if (opt == 'd') bench_secs = atof(optarg);
+        else if (opt == 'r') push_pct = atoi(optarg);
+        else if (opt == 'f') prefill = atol(optarg);
+        else {
+            printf(USAGE, argv[0], argv[0]);
+            return 1;
+        }
     }
+    if (argc - optind < 1) {
+        printf(USAGE, argv[0], argv[0]);
+        return 1;
+    }
+    int selected = 0;
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+        if (strcmp(only, "all") == 0 || strcmp(only, variants[v].option) == 0) selected++;
+    }
+    if (selected == 0 || bench_secs <= 0 || push_pct < 0 || push_pct > 100 || prefill < 0) {
+        printf(USAGE, argv[0], argv[0]);
+        return 1;
+    }
+    
+    num_threads = atoi(argv[optind]);
+    node_pool_init(alloc_mode);
 
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(workers[i], NULL);
+    pthread_t *workers = malloc(sizeof(pthread_t) * num_threads);
+    if (workers == NULL) {
+        perror("malloc failed for workers");
+        return 1;
+    }
+    if (lf_stack_init(&cas_stack, num_threads) != 0 || elim_stack_init(&elim_stack, num_threads) != 0 ||
+        fc_stack_init(&fc_stack, num_threads) != 0) {
+        return 1;
+    }
+    cas_stack.backoff = backoff;
+
+    if (bench) {
+        private_ids = 1;
+        double ticks_per_ns = tsc_per_ns();
+        int failed = 0;
+        printf("variant,alloc,backoff,threads,seconds,push_pct,prefill,ops,mops,p50_ns,p99_ns,retries,retries_per_op,empty_pops\n");
+        for (int v = 0; v < NUM_VARIANTS; v++) {
+            if (strcmp(only, "all") != 0 && strcmp(only, variants[v].option) != 0) continue;
+            failed |= run_bench(workers, &variants[v], ticks_per_ns);
+        }
+        destroy_stacks();
+        free(workers);
+        return failed;
     }
 
-    printf("CAS: Remaining nodes \n");
-    print_remaining_nodes();
-    cleanup_stack();
+    if (stress_pairs > 0) {
+        if ((long)num_threads * stress_pairs > INT_MAX) {
+            printf("Too many pairs: node ids are ints\n");
+            return 1;
+        }
+        seen = (int *)calloc((long)num_threads * stress_pairs, sizeof(int));
+        if (seen == NULL) {
+            perror("calloc failed for stress check");
+            return 1;
+        }
+        int failed = 0;
+        for (int v = 0; v < NUM_VARIANTS; v++) {
+            if (strcmp(only, "all") != 0 && strcmp(only, variants[v].option) != 0) continue;
+            failed |= run_stress(workers, &variants[v]);
+        }
+        destroy_stacks();
+        free(seen);
+        free(workers);
+        return failed;
+    }
+
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+        const stack_ops_t *ops = &variants[v];
+        if (strcmp(only, "all") != 0 && strcmp(only, ops->option) != 0) continue;
+
+        printf("%s--- Testing %s ---\n", v > 0 && strcmp(only, "all") == 0 ? "\n" : "", ops->name);
+        node_counter = 0; 
+        
+        for (int i = 0; i < num_threads; i++) {
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+           
+            pthread_create(&workers[i], &attr, thread_func, (void *)ops);
+        }
+
+        for (int i = 0; i < num_threads; i++) {
+            pthread_join(workers[i], NULL);
+        }
+
+        printf("%s: Remaining nodes \n", ops->name);
+        print_remaining_nodes(ops->remaining());
+    }
+    destroy_stacks();
     
     free(workers);
     return 0;
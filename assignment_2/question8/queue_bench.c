@@ -0,0 +1,209 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "mpmc_queue.h"
+#include "mutex_queue.h"
+
+/*
+ * Producer/consumer handoff through the lock-free MPMC queue and through the
+ * mutex + condvar queue, for 1, 2, 4, ... up to max_threads producers and as
+ * many consumers. Every item carries its producer and sequence number, so each
+ * run also checks that nothing was lost or duplicated and that a consumer saw
+ * each producer's items in order.
+ */
+
+#define SEQ_BITS 40 /* item = (producer + 1) << SEQ_BITS | seq; 0 is the stop marker */
+
+long total_items = 4000000;
+size_t batch = 1;
+size_t capacity = 1024;
+
+typedef struct {
+    const char *name;
+    void (*enqueue_batch)(void *q, void *const *data, size_t n);
+    size_t (*dequeue_batch)(void *q, void **data, size_t n);
+} queue_ops_t;
+
+static void mpmc_put(void *q, void *const *data, size_t n) { mpmc_enqueue_batch((mpmc_queue_t *)q, data, n); }
+static size_t mpmc_get(void *q, void **data, size_t n) { return mpmc_dequeue_batch((mpmc_queue_t *)q, data, n); }
+static void mutex_put(void *q, void *const *data, size_t n) { mutex_enqueue_batch((mutex_queue_t *)q, data, n); }
+static size_t mutex_get(void *q, void **data, size_t n) { return mutex_dequeue_batch((mutex_queue_t *)q, data, n); }
+
+static const queue_ops_t queues[] = {
+    {"mpmc", mpmc_put, mpmc_get},
+    {"mutex", mutex_put, mutex_get},
+};
+#define NUM_QUEUES (int)(sizeof(queues) / sizeof(queues[0]))
+
+typedef struct {
+    _Alignas(64) const queue_ops_t *ops;
+    void *queue;
+    int id;
+    int num_producers;
+    long items;          /* producer: items to send; consumer: items received */
+    long long seq_sum;   /* consumer: sum of the sequence numbers received */
+    long out_of_order;
+} worker_t;
+
+void *producer_func(void *arg) {
+    worker_t *me = (worker_t *)arg;
+    void *buf[batch];
+    uintptr_t tag = (uintptr_t)(me->id + 1) << SEQ_BITS;
+
+    for (long seq = 0; seq < me->items; ) {
+        size_t n = 0;
+        while (n < batch && seq < me->items) {
+            buf[n++] = (void *)(tag | (uintptr_t)seq++);
+        }
+        me->ops->enqueue_batch(me->queue, buf, n);
+    }
+    pthread_exit(NULL);
+}
+
+void *consumer_func(void *arg) {
+    worker_t *me = (worker_t *)arg;
+    void *buf[batch];
+    long *last = (long *)malloc(me->num_producers * sizeof(long));
+    for (int p = 0; p < me->num_producers; p++) last[p] = -1;
+    int stops = 0;
+
+    while (stops == 0) {
+        size_t n = me->ops->dequeue_batch(me->queue, buf, batch);
+        for (size_t i = 0; i < n; i++) {
+            uintptr_t item = (uintptr_t)buf[i];
+            if (item == 0) {
+                stops++;
+                continue;
+            }
+            int p = (int)(item >> SEQ_BITS) - 1;
+            long seq = (long)(item & (((uintptr_t)1 << SEQ_BITS) - 1));
+            if (seq <= last[p]) me->out_of_order++;
+            last[p] = seq;
+            me->items++;
+            me->seq_sum += seq;
+        }
+    }
+    // one stop marker per consumer; a batch may have swallowed someone else's
+    void *stop = NULL;
+    for (int s = 1; s < stops; s++) {
+        me->ops->enqueue_batch(me->queue, &stop, 1);
+    }
+    free(last);
+    pthread_exit(NULL);
+}
+
+int run(const queue_ops_t *ops, int num_producers, int num_consumers) {
+    mpmc_queue_t mpmc;
+    mutex_queue_t locked;
+    void *queue;
+    if (ops->enqueue_batch == mpmc_put) {
+        if (mpmc_init(&mpmc, capacity) != 0) return 1;
+        queue = &mpmc;
+    } else {
+        if (mutex_queue_init(&locked, capacity) != 0) return 1;
+        queue = &locked;
+    }
+
+    int num_workers = num_producers + num_consumers;
+    worker_t *workers = (worker_t *)aligned_alloc(64, num_workers * sizeof(worker_t));
+    pthread_t *threads = (pthread_t *)malloc(num_workers * sizeof(pthread_t));
+    if (workers == NULL || threads == NULL) {
+        perror("malloc failed for workers");
+        return 1;
+    }
+    memset(workers, 0, num_workers * sizeof(worker_t));
+
+    long per_producer = total_items / num_producers;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_workers; i++) {
+        worker_t *w = &workers[i];
+        w->ops = ops;
+        w->queue = queue;
+        w->num_producers = num_producers;
+        if (i < num_producers) {
+            w->id = i;
+            w->items = per_producer;
+            pthread_create(&threads[i], NULL, producer_func, w);
+        } else {
+            w->id = i - num_producers;
+            pthread_create(&threads[i], NULL, consumer_func, w);
+        }
+    }
+    for (int i = 0; i < num_producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    void *stop = NULL;
+    for (int c = 0; c < num_consumers; c++) {
+        ops->enqueue_batch(queue, &stop, 1);
+    }
+    for (int i = num_producers; i < num_workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    long received = 0, out_of_order = 0;
+    long long seq_sum = 0;
+    for (int i = num_producers; i < num_workers; i++) {
+        received += workers[i].items;
+        seq_sum += workers[i].seq_sum;
+        out_of_order += workers[i].out_of_order;
+    }
+    long sent = per_producer * num_producers;
+    long long expected_sum = (long long)num_producers * per_producer * (per_producer - 1) / 2;
+    int ok = received == sent && seq_sum == expected_sum && out_of_order == 0;
+
+    printf("%s,%d,%d,%zu,%zu,%ld,%.4f,%.2f,%s\n", ops->name, num_producers, num_consumers, batch, capacity,
+           sent, secs, sent / secs / 1e6, ok ? "ok" : "FAILED");
+    fflush(stdout);
+
+    if (queue == &mpmc) mpmc_destroy(&mpmc);
+    else mutex_queue_destroy(&locked);
+    free(workers);
+    free(threads);
+    return ok ? 0 : 1;
+}
+
+#define USAGE "Usage: %s [--queue mpmc|mutex|all] [--items N] [--batch B] [--capacity C] <max_threads>\n"
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"queue", required_argument, NULL, 'q'},
+        {"items", required_argument, NULL, 'n'},    /* items per run, split over the producers */
+        {"batch", required_argument, NULL, 'b'},    /* items per enqueue / dequeue call */
+        {"capacity", required_argument, NULL, 'c'},
+        {NULL, 0, NULL, 0}
+    };
+    const char *only = "all";
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 'q') only = optarg;
+        else if (opt == 'n') total_items = atol(optarg);
+        else if (opt == 'b') batch = (size_t)atol(optarg);
+        else if (opt == 'c') capacity = (size_t)atol(optarg);
+        else {
+            printf(USAGE, argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 1 || total_items <= 0 || batch == 0 || capacity == 0) {
+        printf(USAGE, argv[0]);
+        return 1;
+    }
+    int max_threads = atoi(argv[optind]);
+
+    int failed = 0;
+    printf("queue,producers,consumers,batch,capacity,items,seconds,mitems_per_s,check\n");
+    for (int q = 0; q < NUM_QUEUES; q++) {
+        if (strcmp(only, "all") != 0 && strcmp(only, queues[q].name) != 0) continue;
+        for (int t = 1; t <= max_threads; t *= 2) {
+            failed |= run(&queues[q], t, t);
+        }
+    }
+    return failed;
+}
@@ -1,30 +1,201 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <string.h> 
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "prefault.h"
+#include "thp.h"
+
+#define HUGE_2M (2UL << 20)
+
+/*
+ * Ways to stand up a zeroed buffer of total_size bytes with every page
+ * resident. Each strategy allocates, then the init phase makes the pages
+ * real: malloc needs a memset to be zero, everything else is zero already and
+ * only needs one write per page to fault it in. The init phase runs on
+ * `threads` threads (common/prefault.c), each on its own slice.
+ */
+typedef struct {
+    char *base;     // what to give back
+    size_t len;
+    char *ptr;      // the buffer, inside [base, base + len)
+} region_t;
+
+typedef struct {
+    const char *name;
+    int (*alloc)(region_t *r, size_t size);   // 0 on success, errno value on failure
+    int needs_memset;
+    void (*release)(region_t *r);
+    int optional;   // needs pages reserved by the admin, so failing under --strategy all is only reported
+} strategy_t;
+
+static int alloc_malloc(region_t *r, size_t size) {
+    r->base = r->ptr = (char *)malloc(size);
+    return r->ptr ? 0 : ENOMEM;
+}
+
+static int alloc_calloc(region_t *r, size_t size) {
+    // large calloc comes straight from mmap, so glibc skips zeroing what the kernel already zeroed
+    r->base = r->ptr = (char *)calloc(1, size);
+    return r->ptr ? 0 : ENOMEM;
+}
+
+static void release_malloc(region_t *r) {
+    free(r->base);
+}
+
+static int map_anon(region_t *r, size_t size, int flags) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (p == MAP_FAILED) return errno;
+    r->base = r->ptr = (char *)p;
+    r->len = size;
+    return 0;
+}
+
+static int alloc_mmap(region_t *r, size_t size) {
+    return map_anon(r, size, 0);
+}
+
+static int alloc_populate(region_t *r, size_t size) {
+    return map_anon(r, size, MAP_POPULATE);
+}
+
+static int alloc_thp(region_t *r, size_t size) {
+    r->base = r->ptr = (char *)thp_map(size, &r->len);
+    return r->ptr ? 0 : errno;
+}
+
+static int alloc_hugetlb(region_t *r, size_t size) {
+    size_t len = (size + HUGE_2M - 1) & ~(HUGE_2M - 1);
+    return map_anon(r, len, MAP_HUGETLB);
+}
+
+static void release_map(region_t *r) {
+    munmap(r->base, r->len);
+}
+
+static const strategy_t strategies[] = {
+    {"malloc", alloc_malloc, 1, release_malloc, 0},
+    {"calloc", alloc_calloc, 0, release_malloc, 0},
+    {"mmap", alloc_mmap, 0, release_map, 0},
+    {"populate", alloc_populate, 0, release_map, 0},
+    {"thp", alloc_thp, 0, release_map, 0},
+    {"hugetlb", alloc_hugetlb, 0, release_map, 1},
+};
+#define NUM_STRATEGIES (int)(sizeof(strategies) / sizeof(strategies[0]))
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void faults(long *minor, long *major) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    *minor = ru.ru_minflt;
+    *major = ru.ru_majflt;
+}
+
+int run_strategy(const strategy_t *s, size_t total_size, int page_size, int threads, int populate_write) {
+    region_t r = {NULL, 0, NULL};
+    long min0, maj0, min1, maj1, min2, maj2, min3, maj3;
+
+    faults(&min0, &maj0);
+    double t0 = now_ms();
+    int err = s->alloc(&r, total_size);
+    double t1 = now_ms();
+    faults(&min1, &maj1);
+    if (err) {
+        if (r.base) s->release(&r);
+        printf("%s,%d,,%zu,,,,,,,,,,,%s\n", s->name, threads, total_size, strerror(err));
+        return 1;
+    }
+
+    enum prefault_mode mode = s->needs_memset ? PREFAULT_ZERO : populate_write ? PREFAULT_POPULATE : PREFAULT_TOUCH;
+    prefault_stats_t init;
+    prefault(r.ptr, total_size, page_size, threads, mode, &init);
+    double t2 = now_ms();
+    faults(&min2, &maj2);
+    long thp_kb = anon_huge_kb(r.ptr);
+
+    s->release(&r);
+    double t3 = now_ms();
+    faults(&min3, &maj3);
+
+    printf("%s,%d,%s,%zu,%.3f,%.3f,%.3f,%.3f,%ld,%ld,%ld,%ld,%.2f,%.0f,ok\n", s->name, init.threads,
+           prefault_mode_name(init.mode), total_size, t1 - t0, t2 - t1, t3 - t2, t3 - t0, min1 - min0,
+           min2 - min1, maj3 - maj0, thp_kb, prefault_gb_per_s(&init), prefault_faults_per_s(&init));
+    return 0;
+}
+
+#define USAGE "Usage: %s [--strategy malloc|calloc|mmap|populate|thp|hugetlb|all] [--repeat R]\n" \
+              "          [--threads T] [--sweep] [--populate-write] <number of pages>\n"
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <number of pages>\n", argv[0]);
+    static struct option long_options[] = {
+        {"strategy", required_argument, NULL, 's'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"threads", required_argument, NULL, 't'},      /* threads faulting the buffer in */
+        {"sweep", no_argument, NULL, 'w'},              /* 1, 2, 4, ... up to --threads */
+        {"populate-write", no_argument, NULL, 'p'},     /* MADV_POPULATE_WRITE instead of touching */
+        {NULL, 0, NULL, 0}
+    };
+    const char *only = "malloc";
+    int repeat = 1;
+    int max_threads = 1;
+    int sweep = 0;
+    int populate_write = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 's') only = optarg;
+        else if (opt == 'r') repeat = atoi(optarg);
+        else if (opt == 't') max_threads = atoi(optarg);
+        else if (opt == 'w') sweep = 1;
+        else if (opt == 'p') populate_write = 1;
+        else {
+            printf(USAGE, argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 1 || repeat <= 0 || max_threads <= 0) {
+        printf(USAGE, argv[0]);
         return 1;
     }
 
-    long n_pages = atol(argv[1]);
-    int page_size = getpagesize(); 
+    long n_pages = atol(argv[optind]);
+    int page_size = getpagesize();
     size_t total_size = n_pages * page_size;
 
     printf("Page size: %d bytes\n", page_size);
     printf("Allocating and initializing %ld pages (Total: %zu bytes)\n", n_pages, total_size);
 
-    char *ptr = (char *)malloc(total_size);
-
-    if (ptr == NULL) {
-        perror("Malloc failed");
+    int all = strcmp(only, "all") == 0;
+    int found = 0, failed = 0;
+    printf("strategy,threads,init_mode,bytes,alloc_ms,init_ms,free_ms,total_ms,alloc_minflt,init_minflt,majflt,"
+           "thp_kb,init_gb_per_s,init_faults_per_s,status\n");
+    for (int i = 0; i < NUM_STRATEGIES; i++) {
+        if (!all && strcmp(only, strategies[i].name) != 0) continue;
+        found = 1;
+        for (int t = sweep ? 1 : max_threads; ; t *= 2) {
+            if (t > max_threads) t = max_threads;
+            for (int k = 0; k < repeat; k++) {
+                if (run_strategy(&strategies[i], total_size, page_size, t, populate_write) != 0 &&
+                    !(all && strategies[i].optional)) {
+                    failed = 1;
+                }
+            }
+            if (t == max_threads) break;
+        }
+    }
+    if (!found) {
+        printf(USAGE, argv[0]);
         return 1;
     }
-
-    memset(ptr, 0, total_size);
-
-    free(ptr);
-    return 0;
+    return failed;
 }
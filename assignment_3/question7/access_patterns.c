@@ -0,0 +1,139 @@
+#define _GNU_SOURCE
+#include "access_patterns.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static inline unsigned long long next_random(unsigned long long *state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/* random value in [0, n), n < 2^32 */
+static inline size_t random_below(unsigned long long *state, size_t n) {
+    return (size_t)((next_random(state) >> 32) * n >> 32);
+}
+
+static unsigned long run_seq(char *buf, size_t len, size_t stride, long accesses, unsigned long long seed) {
+    (void)stride;
+    (void)seed;
+    unsigned long sum = 0;
+    size_t off = 0;
+    for (long i = 0; i < accesses; i++) {
+        sum += *(volatile unsigned long *)(buf + off);
+        off += LINE_SIZE;
+        if (off >= len) off = 0;
+    }
+    return sum;
+}
+
+static unsigned long run_stride(char *buf, size_t len, size_t stride, long accesses, unsigned long long seed) {
+    (void)seed;
+    unsigned long sum = 0;
+    size_t start = 0, off = 0;
+    if (stride > len) stride = len;
+    for (long i = 0; i < accesses; i++) {
+        sum += *(volatile unsigned long *)(buf + off);
+        off += stride;
+        if (off >= len) {
+            start += LINE_SIZE;
+            if (start >= stride) start = 0;
+            off = start;
+        }
+    }
+    return sum;
+}
+
+static unsigned long run_random(char *buf, size_t len, size_t stride, long accesses, unsigned long long seed) {
+    (void)stride;
+    unsigned long sum = 0;
+    size_t lines = len / LINE_SIZE;
+    unsigned long long rng = seed ? seed : 1;
+    for (long i = 0; i < accesses; i++) {
+        sum += *(volatile unsigned long *)(buf + random_below(&rng, lines) * LINE_SIZE);
+    }
+    return sum;
+}
+
+/* links every line into one random cycle: a shuffled order of the lines, each pointing at the next */
+static void setup_chase(char *buf, size_t len, unsigned long long seed) {
+    size_t lines = len / LINE_SIZE;
+    size_t *order = (size_t *)malloc(lines * sizeof(size_t));
+    if (order == NULL) {
+        // fall back to a cycle in address order
+        for (size_t i = 0; i < lines; i++) {
+            *(char **)(buf + i * LINE_SIZE) = buf + (i + 1 < lines ? i + 1 : 0) * LINE_SIZE;
+        }
+        return;
+    }
+    unsigned long long rng = seed ? seed : 1;
+    for (size_t i = 0; i < lines; i++) order[i] = i;
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = random_below(&rng, i + 1);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        *(char **)(buf + order[i] * LINE_SIZE) = buf + order[i + 1 < lines ? i + 1 : 0] * LINE_SIZE;
+    }
+    free(order);
+}
+
+static unsigned long run_chase(char *buf, size_t len, size_t stride, long accesses, unsigned long long seed) {
+    (void)len;
+    (void)stride;
+    (void)seed;
+    char *p = buf;
+    for (long i = 0; i < accesses; i++) {
+        p = *(char *volatile *)p;
+    }
+    return (unsigned long)p;
+}
+
+const access_pattern_t access_patterns[] = {
+    {"seq", NULL, run_seq},
+    {"stride", NULL, run_stride},
+    {"random", NULL, run_random},
+    {"chase", setup_chase, run_chase},
+};
+const int num_access_patterns = sizeof(access_patterns) / sizeof(access_patterns[0]);
+
+const access_pattern_t *find_access_pattern(const char *name) {
+    for (int i = 0; i < num_access_patterns; i++) {
+        if (strcmp(access_patterns[i].name, name) == 0) return &access_patterns[i];
+    }
+    return NULL;
+}
+
+int dtlb_counter_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void dtlb_counter_start(int fd) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+long long dtlb_counter_stop(int fd) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return count;
+}
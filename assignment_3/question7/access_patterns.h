@@ -0,0 +1,44 @@
+#ifndef ACCESS_PATTERNS_H
+#define ACCESS_PATTERNS_H
+
+#include <stddef.h>
+
+#define LINE_SIZE 64
+
+/*
+ * Load patterns over a buffer that is already faulted in, to see what address
+ * translation costs for a given page size. Every access is one 8-byte load.
+ *
+ *   seq     one load per line, in address order, wrapping around
+ *   stride  one load every `stride` bytes; each pass over the buffer starts
+ *           one line further in, so every line gets its turn
+ *   random  one load at a random line; the addresses do not depend on the
+ *           loads, so the CPU can have several misses in flight
+ *   chase   each load reads the address of the next along a random cycle
+ *           through all lines, so every miss is paid in full
+ *
+ * run() returns something derived from the loaded values so they cannot be
+ * optimized away.
+ */
+
+typedef struct {
+    const char *name;
+    void (*setup)(char *buf, size_t len, unsigned long long seed);    // NULL if none
+    unsigned long (*run)(char *buf, size_t len, size_t stride, long accesses, unsigned long long seed);
+} access_pattern_t;
+
+extern const access_pattern_t access_patterns[];
+extern const int num_access_patterns;
+
+const access_pattern_t *find_access_pattern(const char *name);
+
+/*
+ * dTLB load misses of the calling thread in user space, through
+ * perf_event_open. open returns -1 (errno set) where the kernel, the CPU or
+ * perf_event_paranoid does not allow it; stop returns -1 on a failed read.
+ */
+int dtlb_counter_open(void);
+void dtlb_counter_start(int fd);
+long long dtlb_counter_stop(int fd);
+
+#endif
@@ -1,69 +1,294 @@
-#define _GNU_SOURCE  
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <time.h>
+#include <getopt.h>
+#include "prefault.h"
+#include "thp.h"
+#include "access_patterns.h"
 
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        printf("Usage: %s <number of pages>\n", argv[0]);
-        return 1;
+#define HUGE_2M THP_SIZE
+#define HUGE_1G (1UL << 30)
+
+/*
+ * What backs the mapping. Asking for one that the system cannot give (no
+ * hugetlb pages reserved, THP disabled) falls through to the next entry, so
+ * 1g -> 2m -> thp -> 4k.
+ */
+typedef struct {
+    const char *name;
+    size_t page_size;   // 0 for the base page size
+    int flags;          // extra mmap flags
+} backing_t;
+
+static const backing_t backings[] = {
+    {"1g", HUGE_1G, MAP_HUGETLB | (30 << MAP_HUGE_SHIFT)},
+    {"2m", HUGE_2M, MAP_HUGETLB | (21 << MAP_HUGE_SHIFT)},
+    {"thp", HUGE_2M, 0},
+    {"4k", 0, 0},
+};
+#define NUM_BACKINGS (int)(sizeof(backings) / sizeof(backings[0]))
+#define BACKING_THP 2
+
+static size_t backing_page_size(const backing_t *b) {
+    return b->page_size ? b->page_size : (size_t)getpagesize();
+}
+
+/*
+ * Distance between the touches that fault a mapping with backing b in. THP
+ * may back part of the range with base pages, so it is touched once per base
+ * page; touches inside a page that is already huge cost no fault.
+ */
+static size_t fault_step(int b) {
+    return b == BACKING_THP ? (size_t)getpagesize() : backing_page_size(&backings[b]);
+}
+
+/* maps at least size bytes with backing b; the mapped length goes to *len. NULL with errno set on failure */
+static char *map_backing(int b, size_t size, size_t *len) {
+    size_t page = backing_page_size(&backings[b]);
+    *len = (size + page - 1) & ~(page - 1);
+
+    if (b != BACKING_THP) {
+        void *p = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | backings[b].flags, -1, 0);
+        return p == MAP_FAILED ? NULL : (char *)p;
     }
 
-    int num_pages = atoi(argv[1]);
-    int page_size = getpagesize(); 
-    size_t total_size = (size_t)num_pages * page_size;
+    if (!thp_enabled()) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    return (char *)thp_map(size, len);
+}
 
-    printf("Allocating %d pages of %d bytes (Total: %zu bytes)\n", num_pages, page_size, total_size);
+/*
+ * Maps at least size bytes with backing b, or with the first one after it that
+ * works when fallback is set. Returns the backing obtained, -1 if none.
+ */
+static int map_with_fallback(int b, int fallback, size_t size, char **addr, size_t *len, int verbose) {
+    for (; b < NUM_BACKINGS; b++) {
+        *addr = map_backing(b, size, len);
+        if (*addr != NULL) return b;
+        if (verbose) printf("%s backing not available (%s)%s\n", backings[b].name, strerror(errno),
+                            fallback && b + 1 < NUM_BACKINGS ? ", falling back" : "");
+        if (!fallback) break;
+    }
+    return -1;
+}
 
-    char *addr;
+#define SWEEP_MIN (32UL << 10)
+#define DEFAULT_ACCESSES (1L << 22)
 
-    // Start Timer 
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+static volatile unsigned long sink;
+
+/*
+ * Access-pattern mode. For every working-set size (doubling from 32 KB up to
+ * max_ws with --sweep) and every backing asked for, map and fault in the
+ * buffer, then time each pattern over its first ws bytes. Faults are taken
+ * before the timed loops; their cost per fault goes in fault_ns. page_size is
+ * the page size asked for; thp_kb is how much of the mapping the kernel
+ * actually backed with huge pages (empty when it cannot be read).
+ */
+static int run_access_sweep(const access_pattern_t *only, int backing, size_t max_ws, int sweep, long accesses,
+                            size_t stride, int threads, enum prefault_mode mode) {
+    int counter = dtlb_counter_open();
+    if (counter < 0) {
+        printf("dTLB miss counter not available (%s), leaving those columns empty\n", strerror(errno));
+    }
+    printf("pattern,backing,page_size,thp_kb,working_set,accesses,ns_per_access,dtlb_misses,"
+           "dtlb_misses_per_access,fault_ns,status\n");
+
+    int first = backing < 0 ? 0 : backing;
+    int last = backing < 0 ? NUM_BACKINGS - 1 : backing;
+    int failed = 0;
+    for (size_t ws = sweep && SWEEP_MIN < max_ws ? SWEEP_MIN : max_ws; ; ws *= 2) {
+        if (ws > max_ws) ws = max_ws;
+        for (int b = first; b <= last; b++) {
+            char *addr;
+            size_t map_len;
+            // a single backing falls back like the fault mode does, with --backing all each one stands alone
+            int got = map_with_fallback(b, backing >= 0, ws, &addr, &map_len, 0);
+            if (got < 0) {
+                const char *err = strerror(errno);
+                for (int p = 0; p < num_access_patterns; p++) {
+                    if (only && only != &access_patterns[p]) continue;
+                    printf("%s,%s,%zu,,%zu,,,,,,%s\n", access_patterns[p].name, backings[b].name,
+                           backing_page_size(&backings[b]), ws, err);
+                }
+                failed = 1;
+                continue;
+            }
+            size_t page_size = backing_page_size(&backings[got]);
+            prefault_stats_t faults;
+            // every base page of a thp mapping, so none of it faults inside the timed loops
+            prefault(addr, map_len, fault_step(got), threads, mode, &faults);
+            double fault_ns = faults.minor_faults > 0 ? faults.secs * 1e9 / faults.minor_faults : 0;
+            long thp_kb = anon_huge_kb(addr);
+
+            for (int p = 0; p < num_access_patterns; p++) {
+                const access_pattern_t *pat = &access_patterns[p];
+                if (only && only != pat) continue;
+                if (pat->setup) pat->setup(addr, ws, 1);
+
+                struct timespec start, end;
+                long long misses = -1;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                if (counter >= 0) dtlb_counter_start(counter);
+                sink += pat->run(addr, ws, stride, accesses, 1);
+                if (counter >= 0) misses = dtlb_counter_stop(counter);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+                printf("%s,%s,%zu,", pat->name, backings[got].name, page_size);
+                if (thp_kb >= 0) printf("%ld,", thp_kb);
+                else printf(",");
+                printf("%zu,%ld,%.2f,", ws, accesses, ns / accesses);
+                if (misses >= 0) printf("%lld,%.4f,", misses, (double)misses / accesses);
+                else printf(",,");
+                printf("%.0f,ok\n", fault_ns);
+            }
+            munmap(addr, map_len);
+        }
+        if (ws == max_ws) break;
+    }
+    if (counter >= 0) close(counter);
+    // a backing missing from "all" is reported in its rows, not as a failure
+    return backing < 0 ? 0 : failed;
+}
 
-    // Option 1:
-    //addr = (char*) mmap(NULL, total_size, PROT_READ | PROT_WRITE, 
-    //                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#define USAGE "Usage: %s [--backing 4k|thp|2m|1g] [--threads T] [--populate-write] <number of pages>\n" \
+              "       %s --pattern seq|stride|random|chase|all [--backing 4k|thp|2m|1g|all] [--sweep]\n" \
+              "          [--accesses N] [--stride BYTES] [--threads T] [--populate-write] <number of pages>\n"
 
+int main(int argc, char** argv) {
+    static struct option long_options[] = {
+        {"backing", required_argument, NULL, 'b'},      /* page size to ask for, falls back when unavailable */
+        {"threads", required_argument, NULL, 't'},      /* threads taking the page faults */
+        {"populate-write", no_argument, NULL, 'p'},     /* MADV_POPULATE_WRITE instead of touching */
+        {"pattern", required_argument, NULL, 'a'},      /* time loads over the mapping instead of its faults */
+        {"sweep", no_argument, NULL, 'w'},              /* working sets from 32 KB doubling up to the size given */
+        {"accesses", required_argument, NULL, 'n'},     /* loads per pattern */
+        {"stride", required_argument, NULL, 's'},       /* bytes between loads of the stride pattern */
+        {NULL, 0, NULL, 0}
+    };
+    const char *backing_name = "2m";
+    const char *pattern_name = NULL;
+    int threads = 1;
+    int sweep = 0;
+    long accesses = DEFAULT_ACCESSES;
+    long stride = 4096;
+    enum prefault_mode mode = PREFAULT_TOUCH;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 'b') backing_name = optarg;
+        else if (opt == 't') threads = atoi(optarg);
+        else if (opt == 'p') mode = PREFAULT_POPULATE;
+        else if (opt == 'a') pattern_name = optarg;
+        else if (opt == 'w') sweep = 1;
+        else if (opt == 'n') accesses = atol(optarg);
+        else if (opt == 's') stride = atol(optarg);
+        else {
+            printf(USAGE, argv[0], argv[0]);
+            return 1;
+        }
+    }
+    int requested = -1;
+    for (int b = 0; b < NUM_BACKINGS; b++) {
+        if (strcmp(backing_name, backings[b].name) == 0) requested = b;
+    }
+    const access_pattern_t *pattern = NULL;
+    if (pattern_name && strcmp(pattern_name, "all") != 0) {
+        pattern = find_access_pattern(pattern_name);
+        if (pattern == NULL) requested = -2;
+    }
+    // "all" backings only in the access-pattern mode
+    if (requested == -1 && pattern_name && strcmp(backing_name, "all") == 0) requested = -3;
+    if (argc - optind < 1 || threads <= 0 || accesses <= 0 || stride < LINE_SIZE || requested == -1 ||
+        requested == -2) {
+        printf(USAGE, argv[0], argv[0]);
+        return 1;
+    }
 
+    // the size is counted in base pages, so every backing maps the same amount (rounded up to its page size)
+    int num_pages = atoi(argv[optind]);
+    int base_page_size = getpagesize();
+    size_t total_size = (size_t)num_pages * base_page_size;
 
-    // Option 2
+    if (pattern_name) {
+        if (total_size < 2 * LINE_SIZE) {
+            printf(USAGE, argv[0], argv[0]);
+            return 1;
+        }
+        return run_access_sweep(pattern, requested < 0 ? -1 : requested, total_size, sweep, accesses,
+                                (size_t)stride, threads, mode);
+    }
 
-    addr = (char*) mmap(NULL, total_size, PROT_READ | PROT_WRITE, 
-                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    printf("Allocating %d pages of %d bytes (Total: %zu bytes)\n", num_pages, base_page_size, total_size);
 
+    char *addr;
+    size_t map_len;
+    int got = map_with_fallback(requested, 1, total_size, &addr, &map_len, 1);
 
     // Check for failure
-    if (addr == MAP_FAILED) {
+    if (got < 0) {
         perror("mmap failed");
         exit(1);
     }
+    size_t page_size = backing_page_size(&backings[got]);
+    size_t pages = map_len / page_size;
+
+    // Start Timer
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Fault every page in, split over the threads
+    prefault_stats_t faults;
+    prefault(addr, map_len, fault_step(got), threads, mode, &faults);
+
+    //End timer
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
     char c = 'a';
-    for(int i = 0; i < num_pages; i++) {
+    for(size_t i = 0; i < pages; i++) {
         addr[i * page_size] = c;
         c++;
     }
 
-    //End timer
-    clock_gettime(CLOCK_MONOTONIC, &end);
-
     // Calculate time
     long seconds = end.tv_sec - start.tv_sec;
     long nanoseconds = end.tv_nsec - start.tv_nsec;
     double elapsed = seconds + nanoseconds*1e-9;
 
+    long huge_kb = got == BACKING_THP ? anon_huge_kb(addr) : -1;
+    if (huge_kb >= 0) {
+        // THP is best effort: count what the kernel actually gave, not what was asked for
+        size_t huge_pages = (size_t)huge_kb * 1024 / HUGE_2M;
+        size_t base_pages = (map_len - huge_pages * HUGE_2M) / base_page_size;
+        printf("Backing: %s (asked for %s), %zu pages of %lu bytes + %zu pages of %d bytes (Total: %zu bytes)\n",
+               backings[got].name, backings[requested].name, huge_pages, HUGE_2M, base_pages, base_page_size,
+               map_len);
+    } else {
+        printf("Backing: %s (asked for %s), %zu pages of %zu bytes (Total: %zu bytes)\n", backings[got].name,
+               backings[requested].name, pages, page_size, map_len);
+    }
     printf("Elapsed time: %.9f seconds\n", elapsed);
+    printf("Faulting in: %d thread(s), %s, %ld minor faults, %.0f faults/s, %.2f GB/s\n", faults.threads,
+           prefault_mode_name(faults.mode), faults.minor_faults, prefault_faults_per_s(&faults),
+           prefault_gb_per_s(&faults));
+    if (faults.minor_faults > 0) {
+        printf("Per fault: %.0f ns\n", faults.secs * 1e9 / faults.minor_faults);
+    }
+
 
-    
-    for(int i = 0; (i < num_pages && i < 16); i++) {
+    for(size_t i = 0; (i < pages && i < 16); i++) {
         printf("%c ", addr[i * page_size]);
     }
     printf("\n");
 
-    munmap(addr, total_size);
+    munmap(addr, map_len);
 
     return 0;
 }
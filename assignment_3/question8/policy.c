@@ -0,0 +1,192 @@
+#include "policy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+const policy_ops_t *const policies[] = {
+    &lru_policy, &clock_policy, &clockpro_policy, &arc_policy, &twoq_policy, &lirs_policy,
+};
+const int num_policies = sizeof(policies) / sizeof(policies[0]);
+
+const policy_ops_t *find_policy(const char *name) {
+    for (int i = 0; i < num_policies; i++) {
+        if (strcmp(policies[i]->name, name) == 0) return policies[i];
+    }
+    return NULL;
+}
+
+int policy_sim_init(policy_sim_t *sim, const policy_ops_t *ops, int frames, int num_pages) {
+    memset(sim, 0, sizeof(*sim));
+    sim->ops = ops;
+    sim->frames = frames;
+    sim->frame_page = (int *)malloc(frames * sizeof(int));
+    sim->page_frame = (int *)malloc(num_pages * sizeof(int));
+    sim->state = ops->create(frames, num_pages);
+    if (sim->frame_page == NULL || sim->page_frame == NULL || sim->state == NULL) {
+        perror("malloc failed for the frame pool");
+        policy_sim_destroy(sim);
+        return -1;
+    }
+    memset(sim->page_frame, -1, num_pages * sizeof(int));
+    return 0;
+}
+
+void policy_sim_destroy(policy_sim_t *sim) {
+    if (sim->state) sim->ops->destroy(sim->state);
+    free(sim->frame_page);
+    free(sim->page_frame);
+    sim->state = NULL;
+    sim->frame_page = NULL;
+    sim->page_frame = NULL;
+}
+
+int policy_sim_feed(policy_sim_t *sim, const int *refs, long n) {
+    const policy_ops_t *ops = sim->ops;
+    void *state = sim->state;
+    int *page_frame = sim->page_frame;
+    int used = sim->used;
+    long hits = 0;
+    int failed = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    unsigned long long t0 = __rdtsc();
+    long i;
+    for (i = 0; i < n; i++) {
+        int page = refs[i];
+        if (page_frame[page] >= 0) {
+            hits++;
+            ops->hit(state, page);
+            continue;
+        }
+        int victim = ops->miss(state, page, used == sim->frames);
+        int f;
+        if (used < sim->frames) {
+            f = used++;
+        } else if (victim >= 0 && page_frame[victim] >= 0) {
+            f = page_frame[victim];
+            page_frame[victim] = -1;
+        } else {
+            fprintf(stderr, "%s: evicted page %d is not resident\n", ops->name, victim);
+            failed = 1;
+            break;
+        }
+        sim->frame_page[f] = page;
+        page_frame[page] = f;
+    }
+    unsigned long long t1 = __rdtsc();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    sim->used = used;
+    sim->hits += hits;
+    sim->misses += i - hits;
+    sim->secs += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    sim->cycles += (double)(t1 - t0);
+    return failed ? -1 : 0;
+}
+
+/* LRU: one list, hits move to the tail, the head is evicted */
+
+typedef struct {
+    plist_t list;
+    plink_t *links;
+} lru_state_t;
+
+static void *lru_create(int frames, int num_pages) {
+    lru_state_t *s = (lru_state_t *)malloc(sizeof(lru_state_t));
+    if (s == NULL) return NULL;
+    s->links = (plink_t *)malloc(num_pages * sizeof(plink_t));
+    if (s->links == NULL) {
+        free(s);
+        return NULL;
+    }
+    plist_init(&s->list);
+    return s;
+}
+
+static void lru_hit(void *state, int page) {
+    lru_state_t *s = (lru_state_t *)state;
+    plist_remove(&s->list, s->links, page);
+    plist_push_tail(&s->list, s->links, page);
+}
+
+static int lru_miss(void *state, int page, int full) {
+    lru_state_t *s = (lru_state_t *)state;
+    int victim = full ? plist_pop_head(&s->list, s->links) : -1;
+    plist_push_tail(&s->list, s->links, page);
+    return victim;
+}
+
+static void lru_destroy(void *state) {
+    lru_state_t *s = (lru_state_t *)state;
+    free(s->links);
+    free(s);
+}
+
+const policy_ops_t lru_policy = {"lru", lru_create, lru_hit, lru_miss, lru_destroy};
+
+/* CLOCK: frames in a circle with a reference bit each; the hand clears set bits and evicts the first clear one */
+
+typedef struct {
+    int frames;
+    int used;
+    int hand;
+    int *slot_page;
+    int *page_slot;
+    unsigned char *ref;
+} clock_state_t;
+
+static void *clock_create(int frames, int num_pages) {
+    clock_state_t *s = (clock_state_t *)calloc(1, sizeof(clock_state_t));
+    if (s == NULL) return NULL;
+    s->frames = frames;
+    s->slot_page = (int *)malloc(frames * sizeof(int));
+    s->page_slot = (int *)malloc(num_pages * sizeof(int));
+    s->ref = (unsigned char *)calloc(frames, 1);
+    if (s->slot_page == NULL || s->page_slot == NULL || s->ref == NULL) {
+        free(s->slot_page);
+        free(s->page_slot);
+        free(s->ref);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void clock_hit(void *state, int page) {
+    clock_state_t *s = (clock_state_t *)state;
+    s->ref[s->page_slot[page]] = 1;
+}
+
+static int clock_miss(void *state, int page, int full) {
+    clock_state_t *s = (clock_state_t *)state;
+    int victim = -1;
+    int slot;
+    if (!full) {
+        slot = s->used++;
+    } else {
+        while (s->ref[s->hand]) {
+            s->ref[s->hand] = 0;
+            s->hand = (s->hand + 1) % s->frames;
+        }
+        slot = s->hand;
+        victim = s->slot_page[slot];
+        s->hand = (s->hand + 1) % s->frames;
+    }
+    s->slot_page[slot] = page;
+    s->page_slot[page] = slot;
+    s->ref[slot] = 0;
+    return victim;
+}
+
+static void clock_destroy(void *state) {
+    clock_state_t *s = (clock_state_t *)state;
+    free(s->slot_page);
+    free(s->page_slot);
+    free(s->ref);
+    free(s);
+}
+
+const policy_ops_t clock_policy = {"clock", clock_create, clock_hit, clock_miss, clock_destroy};
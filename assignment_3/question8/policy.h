@@ -0,0 +1,99 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+/*
+ * Page-replacement policies over a fixed pool of frames.
+ *
+ * The frame pool knows which page sits in which frame, so it decides hits and
+ * misses; a policy only keeps its own bookkeeping. On a hit the policy is told
+ * about the access, on a miss it is told about the new page and, when every
+ * frame is taken, names the resident page to evict. Policies with history
+ * (ARC, 2Q, LIRS, CLOCK-Pro) also remember some pages that are no longer
+ * resident.
+ */
+
+typedef struct {
+    const char *name;
+    void *(*create)(int frames, int num_pages);
+    void (*hit)(void *state, int page);
+    int (*miss)(void *state, int page, int full);   // returns the evicted page, -1 if none
+    void (*destroy)(void *state);
+} policy_ops_t;
+
+extern const policy_ops_t lru_policy;
+extern const policy_ops_t clock_policy;
+extern const policy_ops_t clockpro_policy;
+extern const policy_ops_t arc_policy;
+extern const policy_ops_t twoq_policy;
+extern const policy_ops_t lirs_policy;
+
+extern const policy_ops_t *const policies[];
+extern const int num_policies;
+
+const policy_ops_t *find_policy(const char *name);
+
+/* one policy running over its frame pool; references are fed in chunks */
+typedef struct {
+    const policy_ops_t *ops;
+    void *state;
+    int frames;
+    int used;
+    int *frame_page;
+    int *page_frame;    // -1 when not resident
+    long hits;
+    long misses;
+    double secs;        // time spent inside policy_sim_feed
+    double cycles;      // same in TSC ticks
+} policy_sim_t;
+
+int policy_sim_init(policy_sim_t *sim, const policy_ops_t *ops, int frames, int num_pages);
+/* 0 on success, -1 if the policy evicted a page that was not resident */
+int policy_sim_feed(policy_sim_t *sim, const int *refs, long n);
+void policy_sim_destroy(policy_sim_t *sim);
+
+/*
+ * Doubly linked lists of page ids for the policies, threaded through a
+ * per-page link array so removal from the middle is O(1). -1 ends a list.
+ */
+
+typedef struct {
+    int prev;
+    int next;
+} plink_t;
+
+typedef struct {
+    int head;   // least recently inserted
+    int tail;
+    int size;
+} plist_t;
+
+static inline void plist_init(plist_t *l) {
+    l->head = -1;
+    l->tail = -1;
+    l->size = 0;
+}
+
+static inline void plist_push_tail(plist_t *l, plink_t *links, int id) {
+    links[id].prev = l->tail;
+    links[id].next = -1;
+    if (l->tail >= 0) links[l->tail].next = id;
+    else l->head = id;
+    l->tail = id;
+    l->size++;
+}
+
+static inline void plist_remove(plist_t *l, plink_t *links, int id) {
+    if (links[id].prev >= 0) links[links[id].prev].next = links[id].next;
+    else l->head = links[id].next;
+    if (links[id].next >= 0) links[links[id].next].prev = links[id].prev;
+    else l->tail = links[id].prev;
+    l->size--;
+}
+
+static inline int plist_pop_head(plist_t *l, plink_t *links) {
+    int id = l->head;
+    if (id >= 0) plist_remove(l, links, id);
+    return id;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "policy.h"
+#include <stdlib.h>
+
+/*
+ * Full 2Q (Johnson and Shasha, VLDB '94). New pages go to the FIFO A1in
+ * (a quarter of the frames); pages pushed out of it are remembered in the
+ * ghost FIFO A1out (ids only, up to half the number of frames). Only a page
+ * that comes back while it is in A1out is considered hot and enters the LRU
+ * list Am, so a one-time scan cannot flush Am.
+ */
+
+enum { Q_NONE, Q_A1IN, Q_A1OUT, Q_AM };
+
+typedef struct {
+    int kin;
+    int kout;
+    plist_t a1in, a1out, am;
+    plink_t *links;
+    unsigned char *where;
+} twoq_state_t;
+
+static void *twoq_create(int frames, int num_pages) {
+    twoq_state_t *s = (twoq_state_t *)calloc(1, sizeof(twoq_state_t));
+    if (s == NULL) return NULL;
+    s->kin = frames / 4 > 0 ? frames / 4 : 1;
+    s->kout = frames / 2 > 0 ? frames / 2 : 1;
+    s->links = (plink_t *)malloc(num_pages * sizeof(plink_t));
+    s->where = (unsigned char *)calloc(num_pages, 1);
+    if (s->links == NULL || s->where == NULL) {
+        free(s->links);
+        free(s->where);
+        free(s);
+        return NULL;
+    }
+    plist_init(&s->a1in);
+    plist_init(&s->a1out);
+    plist_init(&s->am);
+    return s;
+}
+
+static void twoq_hit(void *state, int page) {
+    twoq_state_t *s = (twoq_state_t *)state;
+    if (s->where[page] == Q_AM) {
+        plist_remove(&s->am, s->links, page);
+        plist_push_tail(&s->am, s->links, page);
+    }
+    // a hit in A1in leaves it in place: correlated references do not make a page hot
+}
+
+/* frees one frame: from A1in while it is over its share (remembering the page), else from Am */
+static int twoq_reclaim(twoq_state_t *s) {
+    int victim;
+    if (s->a1in.size > s->kin || s->am.size == 0) {
+        victim = plist_pop_head(&s->a1in, s->links);
+        if (s->a1out.size >= s->kout) s->where[plist_pop_head(&s->a1out, s->links)] = Q_NONE;
+        plist_push_tail(&s->a1out, s->links, victim);
+        s->where[victim] = Q_A1OUT;
+    } else {
+        victim = plist_pop_head(&s->am, s->links);
+        s->where[victim] = Q_NONE;
+    }
+    return victim;
+}
+
+static int twoq_miss(void *state, int page, int full) {
+    twoq_state_t *s = (twoq_state_t *)state;
+    int remembered = s->where[page] == Q_A1OUT;
+    if (remembered) plist_remove(&s->a1out, s->links, page);
+    int victim = full ? twoq_reclaim(s) : -1;
+    if (remembered) {
+        plist_push_tail(&s->am, s->links, page);
+        s->where[page] = Q_AM;
+    } else {
+        plist_push_tail(&s->a1in, s->links, page);
+        s->where[page] = Q_A1IN;
+    }
+    return victim;
+}
+
+static void twoq_destroy(void *state) {
+    twoq_state_t *s = (twoq_state_t *)state;
+    free(s->links);
+    free(s->where);
+    free(s);
+}
+
+const policy_ops_t twoq_policy = {"2q", twoq_create, twoq_hit, twoq_miss, twoq_destroy};
@@ -0,0 +1,118 @@
+#include "policy.h"
+#include <stdlib.h>
+
+/*
+ * ARC (Megiddo and Modha, FAST '03). T1 holds pages seen once recently, T2
+ * pages seen at least twice; B1 and B2 remember the ids of pages recently
+ * evicted from T1 and T2. A miss that hits B1 means T1 was too small and moves
+ * the target size p of T1 up, a hit in B2 moves it down. T1 + T2 never exceed
+ * c frames and the four lists together never exceed 2c pages.
+ */
+
+enum { ARC_NONE, ARC_T1, ARC_T2, ARC_B1, ARC_B2 };
+
+typedef struct {
+    int c;
+    int p;              // target size of T1
+    plist_t t1, t2, b1, b2;
+    plink_t *links;
+    unsigned char *where;
+} arc_state_t;
+
+static plist_t *arc_list(arc_state_t *s, int which) {
+    switch (which) {
+    case ARC_T1: return &s->t1;
+    case ARC_T2: return &s->t2;
+    case ARC_B1: return &s->b1;
+    default: return &s->b2;
+    }
+}
+
+static void arc_move(arc_state_t *s, int page, int to) {
+    if (s->where[page] != ARC_NONE) plist_remove(arc_list(s, s->where[page]), s->links, page);
+    s->where[page] = to;
+    if (to != ARC_NONE) plist_push_tail(arc_list(s, to), s->links, page);
+}
+
+static void *arc_create(int frames, int num_pages) {
+    arc_state_t *s = (arc_state_t *)calloc(1, sizeof(arc_state_t));
+    if (s == NULL) return NULL;
+    s->c = frames;
+    s->links = (plink_t *)malloc(num_pages * sizeof(plink_t));
+    s->where = (unsigned char *)calloc(num_pages, 1);
+    if (s->links == NULL || s->where == NULL) {
+        free(s->links);
+        free(s->where);
+        free(s);
+        return NULL;
+    }
+    plist_init(&s->t1);
+    plist_init(&s->t2);
+    plist_init(&s->b1);
+    plist_init(&s->b2);
+    return s;
+}
+
+static void arc_hit(void *state, int page) {
+    arc_move((arc_state_t *)state, page, ARC_T2);
+}
+
+/* evicts the LRU page of T1 or T2 into its ghost list and returns it */
+static int arc_replace(arc_state_t *s, int in_b2) {
+    int victim;
+    if (s->t1.size > 0 && (s->t1.size > s->p || (in_b2 && s->t1.size == s->p) || s->t2.size == 0)) {
+        victim = s->t1.head;
+        arc_move(s, victim, ARC_B1);
+    } else {
+        victim = s->t2.head;
+        arc_move(s, victim, ARC_B2);
+    }
+    return victim;
+}
+
+static int arc_miss(void *state, int page, int full) {
+    arc_state_t *s = (arc_state_t *)state;
+    int victim = -1;
+
+    if (s->where[page] == ARC_B1) {
+        int delta = s->b2.size > s->b1.size ? s->b2.size / s->b1.size : 1;
+        s->p = s->p + delta < s->c ? s->p + delta : s->c;
+        if (full) victim = arc_replace(s, 0);
+        arc_move(s, page, ARC_T2);
+        return victim;
+    }
+    if (s->where[page] == ARC_B2) {
+        int delta = s->b1.size > s->b2.size ? s->b1.size / s->b2.size : 1;
+        s->p = s->p - delta > 0 ? s->p - delta : 0;
+        if (full) victim = arc_replace(s, 1);
+        arc_move(s, page, ARC_T2);
+        return victim;
+    }
+
+    // not remembered at all
+    int l1 = s->t1.size + s->b1.size;
+    int total = l1 + s->t2.size + s->b2.size;
+    if (l1 >= s->c) {
+        if (s->t1.size < s->c) {
+            arc_move(s, s->b1.head, ARC_NONE);
+            if (full) victim = arc_replace(s, 0);
+        } else {
+            victim = s->t1.head;
+            arc_move(s, victim, ARC_NONE);
+        }
+    } else {
+        if (total >= 2 * s->c) arc_move(s, s->b2.head, ARC_NONE);
+        if (full) victim = arc_replace(s, 0);
+    }
+    arc_move(s, page, ARC_T1);
+    return victim;
+}
+
+static void arc_destroy(void *state) {
+    arc_state_t *s = (arc_state_t *)state;
+    free(s->links);
+    free(s->where);
+    free(s);
+}
+
+const policy_ops_t arc_policy = {"arc", arc_create, arc_hit, arc_miss, arc_destroy};
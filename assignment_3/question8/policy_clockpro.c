@@ -0,0 +1,209 @@
+#include "policy.h"
+#include <stdlib.h>
+
+/*
+ * CLOCK-Pro (Jiang, Chen and Zhang, USENIX ATC '05): LIRS approximated with
+ * clock hands, so a hit only sets a reference bit like CLOCK.
+ *
+ * All resident pages plus up to `frames` recently evicted cold pages sit on one
+ * circular list. Pages are hot or cold; a cold page starts a test period when
+ * it is brought in and a reference during that period (while resident or
+ * after eviction) makes it hot. Three hands sweep the circle:
+ *   hand_cold  finds the cold page to evict: referenced cold pages in test
+ *              become hot, other referenced ones get a new test period
+ *   hand_hot   turns an unreferenced hot page cold, and ends the test periods
+ *              it passes
+ *   hand_test  ends test periods to bound the number of evicted pages kept
+ * mc, the number of frames for cold pages, grows when a page in its test
+ * period is referenced and shrinks when a test period ends without one.
+ * "Head" of the list is the spot just behind hand_hot, which it reaches last.
+ */
+
+enum {
+    CP_IN_LIST = 1,
+    CP_RESIDENT = 2,
+    CP_HOT = 4,
+    CP_TEST = 8,
+    CP_REF = 16,
+};
+
+typedef struct {
+    int m;              // frames
+    int mc;             // target number of cold resident pages
+    int nhot;
+    int nnonres;
+    int hand_hot, hand_cold, hand_test;
+    plink_t *links;     // circular
+    unsigned char *flags;
+} clockpro_state_t;
+
+static void *clockpro_create(int frames, int num_pages) {
+    clockpro_state_t *s = (clockpro_state_t *)calloc(1, sizeof(clockpro_state_t));
+    if (s == NULL) return NULL;
+    s->m = frames;
+    s->mc = 1;
+    s->hand_hot = s->hand_cold = s->hand_test = -1;
+    s->links = (plink_t *)malloc(num_pages * sizeof(plink_t));
+    s->flags = (unsigned char *)calloc(num_pages, 1);
+    if (s->links == NULL || s->flags == NULL) {
+        free(s->links);
+        free(s->flags);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void cp_insert_head(clockpro_state_t *s, int page) {
+    s->flags[page] |= CP_IN_LIST;
+    if (s->hand_hot < 0) {
+        s->links[page].prev = s->links[page].next = page;
+        s->hand_hot = s->hand_cold = s->hand_test = page;
+        return;
+    }
+    int next = s->hand_hot;
+    int prev = s->links[next].prev;
+    s->links[page].prev = prev;
+    s->links[page].next = next;
+    s->links[prev].next = page;
+    s->links[next].prev = page;
+}
+
+static void cp_remove(clockpro_state_t *s, int page) {
+    int next = s->links[page].next;
+    if (next == page) {
+        s->hand_hot = s->hand_cold = s->hand_test = -1;
+    } else {
+        int prev = s->links[page].prev;
+        s->links[prev].next = next;
+        s->links[next].prev = prev;
+        if (s->hand_hot == page) s->hand_hot = next;
+        if (s->hand_cold == page) s->hand_cold = next;
+        if (s->hand_test == page) s->hand_test = next;
+    }
+    s->flags[page] &= ~CP_IN_LIST;
+}
+
+static void cp_grow_cold(clockpro_state_t *s) {
+    if (s->mc < s->m - 1) s->mc++;
+}
+
+static void cp_shrink_cold(clockpro_state_t *s) {
+    if (s->mc > 1) s->mc--;
+}
+
+/* a test period ends without a reference; a non-resident page is forgotten */
+static void cp_end_test(clockpro_state_t *s, int page) {
+    s->flags[page] &= ~CP_TEST;
+    cp_shrink_cold(s);
+    if (!(s->flags[page] & CP_RESIDENT)) {
+        cp_remove(s, page);
+        s->nnonres--;
+    }
+}
+
+/* runs until one hot page has been turned cold */
+static void cp_run_hand_hot(clockpro_state_t *s) {
+    while (s->nhot > 0) {
+        int p = s->hand_hot;
+        unsigned char f = s->flags[p];
+        if (f & CP_HOT) {
+            s->hand_hot = s->links[p].next;
+            if (f & CP_REF) {
+                s->flags[p] &= ~CP_REF;
+            } else {
+                s->flags[p] &= ~CP_HOT;
+                s->nhot--;
+                return;
+            }
+        } else if (f & CP_TEST) {
+            s->hand_hot = s->links[p].next;
+            cp_end_test(s, p);
+        } else {
+            s->hand_hot = s->links[p].next;
+        }
+    }
+}
+
+/* runs until one non-resident page has been forgotten */
+static void cp_run_hand_test(clockpro_state_t *s) {
+    int before = s->nnonres;
+    while (s->nnonres == before) {
+        int p = s->hand_test;
+        s->hand_test = s->links[p].next;
+        if (!(s->flags[p] & CP_HOT) && (s->flags[p] & CP_TEST)) cp_end_test(s, p);
+    }
+}
+
+static void cp_balance_hot(clockpro_state_t *s) {
+    while (s->nhot > s->m - s->mc) cp_run_hand_hot(s);
+}
+
+/* runs until one cold resident page has been evicted and returns it */
+static int cp_run_hand_cold(clockpro_state_t *s) {
+    for (;;) {
+        int p = s->hand_cold;
+        unsigned char f = s->flags[p];
+        if ((f & CP_HOT) || !(f & CP_RESIDENT)) {
+            s->hand_cold = s->links[p].next;
+            continue;
+        }
+        if (f & CP_REF) {
+            s->flags[p] &= ~CP_REF;
+            cp_remove(s, p);
+            if (f & CP_TEST) {
+                s->flags[p] = (s->flags[p] & ~CP_TEST) | CP_HOT;
+                s->nhot++;
+                cp_grow_cold(s);
+            } else {
+                s->flags[p] |= CP_TEST;
+            }
+            cp_insert_head(s, p);
+            cp_balance_hot(s);
+            continue;
+        }
+        s->hand_cold = s->links[p].next;
+        s->flags[p] &= ~CP_RESIDENT;
+        if (f & CP_TEST) {
+            s->nnonres++;
+            if (s->nnonres > s->m) cp_run_hand_test(s);
+        } else {
+            cp_remove(s, p);
+        }
+        return p;
+    }
+}
+
+static void clockpro_hit(void *state, int page) {
+    clockpro_state_t *s = (clockpro_state_t *)state;
+    s->flags[page] |= CP_REF;
+}
+
+static int clockpro_miss(void *state, int page, int full) {
+    clockpro_state_t *s = (clockpro_state_t *)state;
+    int victim = full ? cp_run_hand_cold(s) : -1;
+
+    if (s->flags[page] & CP_IN_LIST) {
+        // evicted during its test period: it deserved to stay, comes back hot
+        cp_remove(s, page);
+        s->nnonres--;
+        s->flags[page] = CP_RESIDENT | CP_HOT;
+        s->nhot++;
+        cp_grow_cold(s);
+        cp_insert_head(s, page);
+        cp_balance_hot(s);
+    } else {
+        s->flags[page] = CP_RESIDENT | CP_TEST;
+        cp_insert_head(s, page);
+    }
+    return victim;
+}
+
+static void clockpro_destroy(void *state) {
+    clockpro_state_t *s = (clockpro_state_t *)state;
+    free(s->links);
+    free(s->flags);
+    free(s);
+}
+
+const policy_ops_t clockpro_policy = {"clockpro", clockpro_create, clockpro_hit, clockpro_miss, clockpro_destroy};
@@ -0,0 +1,144 @@
+#include "policy.h"
+#include <stdlib.h>
+
+/*
+ * LIRS (Jiang and Zhang, SIGMETRICS '02). Pages are ranked by reuse distance
+ * instead of recency: LIR pages (low inter-reference recency) get 99% of the
+ * frames and are only evicted by becoming HIR; the remaining frames hold
+ * resident HIR pages in the FIFO Q, which is where victims come from.
+ *
+ * The stack S orders LIR pages and recently seen HIR pages (resident or not)
+ * by recency. A HIR page referenced again while still in S has a smaller reuse
+ * distance than the oldest LIR page, so the two swap status. S is pruned so
+ * that its bottom is always a LIR page; a page that falls out of S while not
+ * resident is forgotten.
+ */
+
+enum { LIRS_HIR, LIRS_LIR };
+
+typedef struct {
+    int llirs;          // frames for LIR pages
+    int lir_count;
+    plist_t s, q;       // head = bottom of the stack / front of the queue
+    plink_t *s_links;
+    plink_t *q_links;
+    unsigned char *status;
+    unsigned char *in_s;
+    unsigned char *in_q;
+} lirs_state_t;
+
+static void *lirs_create(int frames, int num_pages) {
+    lirs_state_t *s = (lirs_state_t *)calloc(1, sizeof(lirs_state_t));
+    if (s == NULL) return NULL;
+    int lhirs = frames / 100 > 0 ? frames / 100 : 1;
+    s->llirs = frames - lhirs;
+    s->s_links = (plink_t *)malloc(num_pages * sizeof(plink_t));
+    s->q_links = (plink_t *)malloc(num_pages * sizeof(plink_t));
+    s->status = (unsigned char *)calloc(num_pages, 1);
+    s->in_s = (unsigned char *)calloc(num_pages, 1);
+    s->in_q = (unsigned char *)calloc(num_pages, 1);
+    if (s->s_links == NULL || s->q_links == NULL || s->status == NULL || s->in_s == NULL || s->in_q == NULL) {
+        free(s->s_links);
+        free(s->q_links);
+        free(s->status);
+        free(s->in_s);
+        free(s->in_q);
+        free(s);
+        return NULL;
+    }
+    plist_init(&s->s);
+    plist_init(&s->q);
+    return s;
+}
+
+/* moves page to the top of S */
+static void lirs_touch(lirs_state_t *s, int page) {
+    if (s->in_s[page]) plist_remove(&s->s, s->s_links, page);
+    plist_push_tail(&s->s, s->s_links, page);
+    s->in_s[page] = 1;
+}
+
+/* drops HIR pages from the bottom of S until it ends in a LIR page */
+static void lirs_prune(lirs_state_t *s) {
+    while (s->s.head >= 0 && s->status[s->s.head] != LIRS_LIR) {
+        s->in_s[plist_pop_head(&s->s, s->s_links)] = 0;
+    }
+}
+
+/* turns the oldest LIR page into a resident HIR page at the end of Q */
+static void lirs_demote_bottom(lirs_state_t *s) {
+    lirs_prune(s); // S can start with HIR pages while there were no LIR pages yet
+    int bottom = plist_pop_head(&s->s, s->s_links);
+    s->in_s[bottom] = 0;
+    s->status[bottom] = LIRS_HIR;
+    s->lir_count--;
+    plist_push_tail(&s->q, s->q_links, bottom);
+    s->in_q[bottom] = 1;
+    lirs_prune(s);
+}
+
+static void lirs_make_lir(lirs_state_t *s, int page) {
+    s->status[page] = LIRS_LIR;
+    s->lir_count++;
+    if (s->lir_count > s->llirs) lirs_demote_bottom(s);
+}
+
+static void lirs_hit(void *state, int page) {
+    lirs_state_t *s = (lirs_state_t *)state;
+    if (s->status[page] == LIRS_LIR) {
+        int was_bottom = s->s.head == page;
+        lirs_touch(s, page);
+        if (was_bottom) lirs_prune(s);
+        return;
+    }
+    // resident HIR page
+    if (s->in_s[page]) {
+        lirs_touch(s, page);
+        plist_remove(&s->q, s->q_links, page);
+        s->in_q[page] = 0;
+        lirs_make_lir(s, page);
+    } else {
+        lirs_touch(s, page);
+        plist_remove(&s->q, s->q_links, page);
+        plist_push_tail(&s->q, s->q_links, page);
+    }
+}
+
+static int lirs_miss(void *state, int page, int full) {
+    lirs_state_t *s = (lirs_state_t *)state;
+    int victim = -1;
+    if (full) {
+        if (s->q.size == 0) lirs_demote_bottom(s);
+        victim = plist_pop_head(&s->q, s->q_links);
+        s->in_q[victim] = 0;   // stays in S as a non-resident HIR page if it is there
+    }
+
+    if (s->lir_count < s->llirs) {
+        // until the LIR frames are used up every new page is LIR
+        lirs_touch(s, page);
+        s->status[page] = LIRS_LIR;
+        s->lir_count++;
+    } else if (s->in_s[page]) {
+        // non-resident HIR page still in S: its reuse distance beats the oldest LIR page
+        lirs_touch(s, page);
+        lirs_make_lir(s, page);
+    } else {
+        lirs_touch(s, page);
+        s->status[page] = LIRS_HIR;
+        plist_push_tail(&s->q, s->q_links, page);
+        s->in_q[page] = 1;
+    }
+    return victim;
+}
+
+static void lirs_destroy(void *state) {
+    lirs_state_t *s = (lirs_state_t *)state;
+    free(s->s_links);
+    free(s->q_links);
+    free(s->status);
+    free(s->in_s);
+    free(s->in_q);
+    free(s);
+}
+
+const policy_ops_t lirs_policy = {"lirs", lirs_create, lirs_hit, lirs_miss, lirs_destroy};
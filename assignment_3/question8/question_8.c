@@ -2,188 +2,456 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
 #include <time.h>
+#include "policy.h"
+#include "trace.h"
 
 #define REFERENCE_STRING_LENGTH 1000
 #define ACTIVE_LIST_THRESHOLD 0.7
 #define MOVE_COUNT_PERCENT 0.2
 #define PLAYER_SLEEP_US 10
+#define PAGEVEC_DEFAULT 32 // inactive pages a player collects before taking list_mutex
+#define PLAYER_CHUNK 1024   // references a player takes from its source at a time
+#define POLICY_DEFAULT_LENGTH 1000000
+#define POLICY_CHUNK 65536  // references handed to a policy at a time
+
+enum { LIST_NONE, LIST_ACTIVE, LIST_INACTIVE };
 
 typedef struct page { 
      int page_id;
-     int reference_bit;
+     int reference_bit;       // set by players, harvested by the checker, both with atomics and no lock
+     int list;                // which list the page is on (LIST_*); written under list_mutex
+     struct page *prev;
      struct page *next;
 } Page;
 
+typedef struct {
+     Page *head;
+     Page *tail;
+     int size;
+} PageList;
+
 // Global shared data
-Page *active_list_head = NULL;
-Page *active_list_tail = NULL;
-Page *inactive_list_head = NULL;
-Page *inactive_list_tail = NULL;
+Page *pages;                  // all N pages, indexed by page_id
+PageList active_list = {NULL, NULL, 0};
+PageList inactive_list = {NULL, NULL, 0};
 
-int active_list_size = 0;
-int *reference_string;
 int *page_stats;
 int N; // Total number of unique pages
 int M; // Checker sleep time in microseconds
 
-pthread_mutex_t list_mutex;
-volatile int player_finished = 0;
+int num_players = 1;
+int pagevec_size = PAGEVEC_DEFAULT;
+int player_sleep_us = PLAYER_SLEEP_US;
 
-// Helper function to find and remove a page from any list
-Page* find_and_remove_page(int page_id) {
-    Page *current = active_list_head;
-    Page *prev = NULL;
-    // Search in active list
-    while (current != NULL && current->page_id != page_id) {
-        prev = current;
-        current = current->next;
-    }
-    if (current != NULL) { // IF Found in active list
-        if (prev == NULL) active_list_head = current->next;
-        else prev->next = current->next;
-        if (active_list_tail == current) active_list_tail = prev;
-        active_list_size--;
-        current->next = NULL;
-        return current;
-    }
+typedef struct {
+     _Alignas(64) int id;
+     ref_source_t src;        // this player's own references
+     int *pagevec;            // pages waiting to be promoted, pagevec_size of them
+     long accesses;
+     long lock_acquisitions;
+     long lock_waits;         // acquisitions that found list_mutex taken
+} Player;
 
-    // Search inside inactive list
-    current = inactive_list_head;
-    prev = NULL;
-    while (current != NULL && current->page_id != page_id) {
-        prev = current;
-        current = current->next;
-    }
-    if (current != NULL) { // IF Found in inactive list
-        if (prev == NULL) inactive_list_head = current->next;
-        else prev->next = current->next;
-        if (inactive_list_tail == current) inactive_list_tail = prev;
-        current->next = NULL;
-        return current;
-    }
-    return NULL; // Should not happen if lists are initialized correctly
+pthread_mutex_t list_mutex;     // protects the two lists only
+int players_finished = 0;
+
+// Unlinks p from list in O(1) through its prev/next pointers
+void list_remove(PageList *list, Page *p) {
+    if (p->prev) p->prev->next = p->next;
+    else list->head = p->next;
+    if (p->next) p->next->prev = p->prev;
+    else list->tail = p->prev;
+    p->prev = NULL;
+    p->next = NULL;
+    __atomic_store_n(&p->list, LIST_NONE, __ATOMIC_RELAXED);
+    list->size--;
+}
+
+// Appends p to the tail of list
+void list_add_tail(PageList *list, Page *p, int which) {
+    p->next = NULL;
+    p->prev = list->tail;
+    if (list->tail) list->tail->next = p;
+    else list->head = p;
+    list->tail = p;
+    __atomic_store_n(&p->list, which, __ATOMIC_RELAXED);
+    list->size++;
+}
+
+// Helper function to find a page and remove it from whichever list it is on
+Page* find_and_remove_page(int page_id) {
+    Page *p = &pages[page_id];
+    if (p->list == LIST_ACTIVE) list_remove(&active_list, p);
+    else if (p->list == LIST_INACTIVE) list_remove(&inactive_list, p);
+    else return NULL; // Should not happen if lists are initialized correctly
+    return p;
 }
 
 // Helper function to add a page to the tail of the active list
 void add_to_active_tail(Page *p) {
-    p->next = NULL;
-    if (active_list_head == NULL) {
-        active_list_head = p;
-        active_list_tail = p;
-    } else {
-        active_list_tail->next = p;
-        active_list_tail = p;
-    }
-    active_list_size++;
+    list_add_tail(&active_list, p, LIST_ACTIVE);
 }
 
 // Helper function to add a page to the tail of the inactive list
 void add_to_inactive_tail(Page *p) {
-    p->next = NULL;
-    if (inactive_list_head == NULL) {
-        inactive_list_head = p;
-        inactive_list_tail = p;
-    } else {
-        inactive_list_tail->next = p;
-        inactive_list_tail = p;
-    }
+    list_add_tail(&inactive_list, p, LIST_INACTIVE);
 }
 
-void *player_thread_func() { 
-    for (int i = 0; i < REFERENCE_STRING_LENGTH; i++) {
-        int page_id = reference_string[i];
+// Demotes pages from the head of the active list once it grows past the threshold; list_mutex held
+void rebalance_lists() {
+    if (active_list.size > (int)(N * ACTIVE_LIST_THRESHOLD)) {
+        int num_to_move = (int)(N * MOVE_COUNT_PERCENT);
+        for (int k = 0; k < num_to_move && active_list.head != NULL; k++) {
+            Page *page_to_move = active_list.head;
+            list_remove(&active_list, page_to_move);
+            add_to_inactive_tail(page_to_move);
+        }
+    }
+}
 
+// Moves a batch of referenced pages to the active list's tail under one lock acquisition
+void promote_pages(Player *me, int *batch, int count) {
+    if (pthread_mutex_trylock(&list_mutex) != 0) {
+        me->lock_waits++;
         pthread_mutex_lock(&list_mutex);
+    }
+    me->lock_acquisitions++;
+    for (int k = 0; k < count; k++) {
+        Page *p = find_and_remove_page(batch[k]);
+        if (p) add_to_active_tail(p);
+    }
+    rebalance_lists();
+    pthread_mutex_unlock(&list_mutex);
+}
 
-        // Find page, remove it from its current list
-        Page *p = find_and_remove_page(page_id);
-        if (p) {
-            // Set reference bit and move to active list's tail
-            p->reference_bit = 1;
-            add_to_active_tail(p);
-        }
+/*
+ * An access only sets the page's reference bit, without any lock. A page that
+ * is not on the active list yet goes into the player's own pagevec, and only a
+ * full pagevec is flushed to the lists, like the kernel's per-CPU LRU batches;
+ * pages already active stay where they are, their reference bit tells the
+ * checker they are in use.
+ */
+void *player_thread_func(void *arg) { 
+    Player *me = (Player *)arg;
+    int refs[PLAYER_CHUNK];
+    int count = 0;
+    long n;
+
+    while ((n = ref_source_next(&me->src, refs, PLAYER_CHUNK)) > 0) {
+        for (long i = 0; i < n; i++) {
+            int page_id = refs[i];
+            Page *p = &pages[page_id];
 
-        // Check for active list being way too big
-        if (active_list_size > (int)(N * ACTIVE_LIST_THRESHOLD)) {
-            int num_to_move = (int)(N * MOVE_COUNT_PERCENT);
-            for (int k = 0; k < num_to_move && active_list_head != NULL; k++) {
-                Page *page_to_move = active_list_head;
-                active_list_head = active_list_head->next;
-                active_list_size--;
-                if (active_list_head == NULL) active_list_tail = NULL;
-                
-                add_to_inactive_tail(page_to_move);
+            // skip the store when the bit is already set so hot pages stay shared in the cache
+            if (!__atomic_load_n(&p->reference_bit, __ATOMIC_RELAXED)) {
+                __atomic_store_n(&p->reference_bit, 1, __ATOMIC_RELAXED);
             }
+            if (__atomic_load_n(&p->list, __ATOMIC_RELAXED) != LIST_ACTIVE) {
+                me->pagevec[count++] = page_id;
+                if (count == pagevec_size) {
+                    promote_pages(me, me->pagevec, count);
+                    count = 0;
+                }
+            }
+            if (player_sleep_us > 0) usleep(player_sleep_us);
         }
-
-        pthread_mutex_unlock(&list_mutex);
-        usleep(PLAYER_SLEEP_US);
+        me->accesses += n;
     }
-    player_finished = 1;
+    if (count > 0) promote_pages(me, me->pagevec, count);
+    __atomic_fetch_add(&players_finished, 1, __ATOMIC_RELEASE);
     pthread_exit(0);
 }
 
+// Collects and clears every set reference bit; needs no lock, so players never wait on it
+void harvest_reference_bits() {
+    for (int i = 0; i < N; i++) {
+        if (__atomic_load_n(&pages[i].reference_bit, __ATOMIC_RELAXED) &&
+            __atomic_exchange_n(&pages[i].reference_bit, 0, __ATOMIC_RELAXED)) {
+            page_stats[i]++;
+        }
+    }
+}
+
 void *checker_thread_func() { 
-    while (!player_finished) {
+    while (__atomic_load_n(&players_finished, __ATOMIC_ACQUIRE) < num_players) {
         usleep(M);
-        pthread_mutex_lock(&list_mutex);
-        Page *current = active_list_head;
-        while (current != NULL) {
-            if (current->reference_bit == 1) {
-                page_stats[current->page_id]++;
-                current->reference_bit = 0;
-            }
-            current = current->next;
-        }
-        pthread_mutex_unlock(&list_mutex);
+        harvest_reference_bits();
     }
+    harvest_reference_bits(); // bits set after the last pass
     pthread_exit(0);
 }
 
-int main(int argc, char *argv[])
-{
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <N_pages> <M_microseconds>\n", argv[0]);
+// All pages back on the inactive list with clear reference bits and statistics
+void reset_pages() {
+    active_list = (PageList){NULL, NULL, 0};
+    inactive_list = (PageList){NULL, NULL, 0};
+    memset(pages, 0, N * sizeof(Page));
+    memset(page_stats, 0, N * sizeof(int));
+    for (int i = 0; i < N; i++) {
+        pages[i].page_id = i;
+        add_to_inactive_tail(&pages[i]);
+    }
+    players_finished = 0;
+}
+
+/*
+ * Runs num_players players, each over its own workload stream of length
+ * references, next to one checker; returns the wall time, or -1 on failure.
+ */
+double run_players(Player *players, const char *workload, long length, unsigned long long seed) {
+    for (int i = 0; i < num_players; i++) {
+        Player *pl = &players[i];
+        memset(pl, 0, sizeof(*pl));
+        pl->id = i;
+        pl->pagevec = malloc(pagevec_size * sizeof(int));
+        if (pl->pagevec == NULL || ref_source_open_workload(&pl->src, workload, N, length, seed + i) != 0) {
+            return -1;
+        }
+    }
+    reset_pages();
+
+    pthread_t *threads = malloc(num_players * sizeof(pthread_t));
+    pthread_t checker;    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_players; i++) {
+        pthread_create(&threads[i], NULL, player_thread_func, &players[i]); 
+    }
+    pthread_create(&checker, NULL, checker_thread_func, NULL); 
+    for (int i = 0; i < num_players; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_join(checker, NULL);
+    free(threads);
+
+    for (int i = 0; i < num_players; i++) {
+        ref_source_close(&players[i].src);
+        free(players[i].pagevec);
+    }
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * Aggregate accesses per second and list_mutex traffic for 1, 2, 4, ... up to
+ * max_players players, each once without batching (pagevec of 1) and once
+ * with the chosen pagevec size. Players do not sleep here.
+ */
+int run_scaling(int max_players, int batch, const char *workload, long length, unsigned long long seed) {
+    Player *players = aligned_alloc(64, max_players * sizeof(Player));
+    if (players == NULL) {
+        perror("malloc failed for players");
         return 1;
     }
-    N = atoi(argv[1]);
-    M = atoi(argv[2]);
+    player_sleep_us = 0;
+    printf("players,pagevec,accesses,seconds,maccesses_per_s,lock_acquisitions,lock_waits,accesses_per_lock\n");
+    for (int p = 1; p <= max_players; p *= 2) {
+        int sizes[2] = {1, batch};
+        for (int b = 0; b < (batch > 1 ? 2 : 1); b++) {
+            num_players = p;
+            pagevec_size = sizes[b];
+            double secs = run_players(players, workload, length, seed);
+            if (secs < 0) {
+                free(players);
+                return 1;
+            }
+            long accesses = 0, locks = 0, waits = 0;
+            for (int i = 0; i < p; i++) {
+                accesses += players[i].accesses;
+                locks += players[i].lock_acquisitions;
+                waits += players[i].lock_waits;
+            }
+            printf("%d,%d,%ld,%.4f,%.2f,%ld,%ld,%.1f\n", p, pagevec_size, accesses, secs, accesses / secs / 1e6,
+                   locks, waits, locks ? (double)accesses / locks : 0.0);
+            fflush(stdout);
+        }
+    }
+    free(players);
+    return 0;
+}
 
-    if (N <= 0 || M <= 0) {
-        fprintf(stderr, "N and M must be positive integers.\n");
+/*
+ * Replays the reference source through each page-replacement policy with a
+ * fixed number of frames, in chunks and without sleeping. With a window, one
+ * CSV row per window of references shows how the hit ratio develops; then one
+ * row per policy gives the totals and the cost of an access, in ns and in TSC
+ * ticks.
+ */
+int run_policies(const char *only, int frames, ref_source_t *src, long window) {
+    int *refs = malloc(POLICY_CHUNK * sizeof(int));
+    policy_sim_t *sims = calloc(num_policies, sizeof(policy_sim_t));
+    int *ran = calloc(num_policies, sizeof(int));
+    if (refs == NULL || sims == NULL || ran == NULL) {
+        perror("malloc failed for the policy runs");
         return 1;
     }
 
-    srand(time(NULL));
-    reference_string = malloc(REFERENCE_STRING_LENGTH * sizeof(int));
-    page_stats = calloc(N, sizeof(int));
+    int failed = 0;
+    if (window > 0) printf("policy,refs,window_hits,window_hit_ratio\n");
+    for (int i = 0; i < num_policies; i++) {
+        const policy_ops_t *ops = policies[i];
+        if (strcmp(only, "all") != 0 && strcmp(only, ops->name) != 0) continue;
+        policy_sim_t *sim = &sims[i];
+        if (policy_sim_init(sim, ops, frames, N) != 0) {
+            failed = 1;
+            continue;
+        }
+        ref_source_rewind(src);
+        long done = 0, in_window = 0, window_hits = 0;
+        for (;;) {
+            long want = POLICY_CHUNK;
+            if (window > 0 && window - in_window < want) want = window - in_window;
+            long n = ref_source_next(src, refs, want);
+            if (n == 0) break;
+            if (policy_sim_feed(sim, refs, n) != 0) {
+                failed = 1;
+                break;
+            }
+            done += n;
+            in_window += n;
+            if (window > 0 && in_window == window) {
+                printf("%s,%ld,%ld,%.4f\n", ops->name, done, sim->hits - window_hits,
+                       (double)(sim->hits - window_hits) / in_window);
+                window_hits = sim->hits;
+                in_window = 0;
+            }
+        }
+        if (window > 0 && in_window > 0) {
+            printf("%s,%ld,%ld,%.4f\n", ops->name, done, sim->hits - window_hits,
+                   (double)(sim->hits - window_hits) / in_window);
+        }
+        ran[i] = 1;
+        policy_sim_destroy(sim);
+    }
 
-    // Random reference string of 1000 accesses
-    for (int i = 0; i < REFERENCE_STRING_LENGTH; i++) {
-        reference_string[i] = rand() % N;
+    if (window > 0) printf("\n");
+    printf("policy,pages,frames,accesses,hits,misses,hit_ratio,ns_per_access,cycles_per_access\n");
+    for (int i = 0; i < num_policies; i++) {
+        if (!ran[i]) continue;
+        policy_sim_t *sim = &sims[i];
+        long accesses = sim->hits + sim->misses;
+        if (accesses == 0) accesses = 1;
+        printf("%s,%d,%d,%ld,%ld,%ld,%.4f,%.1f,%.1f\n", sim->ops->name, N, frames, sim->hits + sim->misses,
+               sim->hits, sim->misses, (double)sim->hits / accesses, sim->secs * 1e9 / accesses,
+               sim->cycles / accesses);
     }
+    free(refs);
+    free(sims);
+    free(ran);
+    return failed;
+}
 
-    // Initialization of pages + putting them in the inactive list
-    for (int i = 0; i < N; i++) {
-        Page *p = malloc(sizeof(Page));
-        p->page_id = i;
-        p->reference_bit = 0;
-        p->next = NULL;
-        add_to_inactive_tail(p);
+#define USAGE "Usage: %s <N_pages> <M_microseconds> [num_players]\n" \
+              "       %s --policy lru|clock|clockpro|arc|2q|lirs|all [--frames F] [--window W]\n" \
+              "          [--trace file [N_pages] | [--workload uniform|zipf[:a]|scan[:f]|loop[:n]] [--length L] [--seed S] N_pages]\n" \
+              "       %s --scale max_players [--pagevec B] [--workload W] [--length L] [--seed S] <N_pages> <M_microseconds>\n"
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"policy", required_argument, NULL, 'p'},
+        {"frames", required_argument, NULL, 'f'},   /* default: a tenth of the pages */
+        {"length", required_argument, NULL, 'l'},   /* references generated per policy */
+        {"trace", required_argument, NULL, 't'},    /* binary or text page id file, mmapped */
+        {"workload", required_argument, NULL, 'w'},
+        {"window", required_argument, NULL, 'W'},   /* references per hit-ratio window, 0 = totals only */
+        {"seed", required_argument, NULL, 's'},
+        {"scale", required_argument, NULL, 'S'},    /* players sweep up to this many */
+        {"pagevec", required_argument, NULL, 'v'},  /* pages a player batches per lock acquisition */
+        {NULL, 0, NULL, 0}
+    };
+    const char *policy = NULL;
+    const char *trace = NULL;
+    const char *workload = "uniform";
+    int scale = 0;
+    int frames = 0;
+    long length = POLICY_DEFAULT_LENGTH;
+    long window = 0;
+    unsigned long long seed = time(NULL);
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (opt == 'p') policy = optarg;
+        else if (opt == 'f') frames = atoi(optarg);
+        else if (opt == 'l') length = atol(optarg);
+        else if (opt == 't') trace = optarg;
+        else if (opt == 'w') workload = optarg;
+        else if (opt == 'W') window = atol(optarg);
+        else if (opt == 's') seed = strtoull(optarg, NULL, 10);
+        else if (opt == 'S') scale = atoi(optarg);
+        else if (opt == 'v') pagevec_size = atoi(optarg);
+        else {
+            fprintf(stderr, USAGE, argv[0], argv[0], argv[0]);
+            return 1;
+        }
     }
+    int args = argc - optind;
 
+    if (policy != NULL) {
+        if (args > 1 || (args == 0 && trace == NULL)) {
+            fprintf(stderr, USAGE, argv[0], argv[0], argv[0]);
+            return 1;
+        }
+        N = args == 1 ? atoi(argv[optind]) : 0;
+        if ((args == 1 && N <= 0) || frames < 0 || length <= 0 || window < 0) {
+            fprintf(stderr, "N, frames, length and window must be positive integers.\n");
+            return 1;
+        }
+        if (strcmp(policy, "all") != 0 && find_policy(policy) == NULL) {
+            fprintf(stderr, "Unknown policy %s\n", policy);
+            return 1;
+        }
+        ref_source_t src;
+        if (trace != NULL) {
+            if (ref_source_open_trace(&src, trace, N) != 0) return 1;
+            N = src.num_pages;
+        } else if (ref_source_open_workload(&src, workload, N, length, seed) != 0) {
+            return 1;
+        }
+        if (frames == 0) frames = N / 10 > 0 ? N / 10 : 1;
+        int failed = run_policies(policy, frames, &src, window);
+        ref_source_close(&src);
+        return failed;
+    }
+
+    if (args != 2 && (args != 3 || scale > 0)) {
+        fprintf(stderr, USAGE, argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    N = atoi(argv[optind]);
+    M = atoi(argv[optind + 1]);
+    if (args == 3) num_players = atoi(argv[optind + 2]);
+
+    if (N <= 0 || M <= 0 || num_players <= 0 || pagevec_size <= 0 || scale < 0) {
+        fprintf(stderr, "N, M, num_players and pagevec must be positive integers.\n");
+        return 1;
+    }
+
+    page_stats = calloc(N, sizeof(int));
+    pages = calloc(N, sizeof(Page));
+    if (page_stats == NULL || pages == NULL) {
+        perror("calloc failed for pages");
+        return 1;
+    }
     pthread_mutex_init(&list_mutex, NULL);
 
-    // Two workers should be created respectively for player and checker
-    pthread_t player;   
-    pthread_t checker;    
+    if (scale > 0) {
+        int failed = run_scaling(scale, pagevec_size, workload, length, seed);
+        free(page_stats);
+        free(pages);
+        pthread_mutex_destroy(&list_mutex);
+        return failed;
+    }
 
-    pthread_create(&player, NULL, player_thread_func, NULL); 
-    pthread_create(&checker, NULL, checker_thread_func, NULL); 
-     
-    pthread_join(player, NULL);
-    pthread_join(checker, NULL);
+    // Players with a random reference string of 1000 accesses each, and one checker
+    Player *players = aligned_alloc(64, num_players * sizeof(Player));
+    if (players == NULL || run_players(players, "uniform", REFERENCE_STRING_LENGTH, seed) < 0) {
+        fprintf(stderr, "Could not start the players\n");
+        return 1;
+    }
+    free(players);
 
     printf("Page_Id, Total_Referenced\n");
     for (int i = 0; i < N; i++) {
@@ -191,7 +459,7 @@ int main(int argc, char *argv[])
     }
      
     printf("\nPages in active list: ");
-    Page *current = active_list_head;
+    Page *current = active_list.head;
     while (current != NULL) {
         printf("%d%s", current->page_id, current->next ? ", " : "");
         current = current->next;
@@ -199,7 +467,7 @@ int main(int argc, char *argv[])
     printf("\n");
 
     printf("Pages in inactive list: ");
-    current = inactive_list_head;
+    current = inactive_list.head;
     while (current != NULL) {
         printf("%d%s", current->page_id, current->next ? ", " : "");
         current = current->next;
@@ -207,22 +475,9 @@ int main(int argc, char *argv[])
     printf("\n");
 
     /*free up resources properly */
-    free(reference_string);
     free(page_stats);
     pthread_mutex_destroy(&list_mutex);
-    
-    current = active_list_head;
-    while (current != NULL) {
-        Page *temp = current;
-        current = current->next;
-        free(temp);
-    }
-    current = inactive_list_head;
-    while (current != NULL) {
-        Page *temp = current;
-        current = current->next;
-        free(temp);
-    }
+    free(pages);
 
     return 0;
 }
@@ -0,0 +1,257 @@
+#include "trace.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNIFF_BYTES 4096
+
+static int is_text(const unsigned char *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = p[i];
+        if (!(c >= '0' && c <= '9') && c != ' ' && c != '\n' && c != '\r' && c != '\t' && c != ',') return 0;
+    }
+    return 1;
+}
+
+/*
+ * next decimal id from the text map, -1 at the end. With pages > 0 the id is
+ * folded modulo pages digit by digit, so ids of any length stay in range;
+ * with pages == 0 (the pass looking for the largest id) it stops growing once
+ * past MAX_TEXT_ID, which is too large anyway.
+ */
+#define MAX_TEXT_ID 0x7fffffffULL
+
+static long long next_text_id(ref_source_t *src, int pages) {
+    const unsigned char *p = src->map;
+    size_t pos = src->pos, len = src->map_len;
+    while (pos < len && (p[pos] < '0' || p[pos] > '9')) pos++;
+    if (pos == len) {
+        src->pos = pos;
+        return -1;
+    }
+    unsigned long long id = 0;
+    while (pos < len && p[pos] >= '0' && p[pos] <= '9') {
+        if (pages > 0) id = (id * 10 + (p[pos] - '0')) % (unsigned)pages;
+        else if (id <= MAX_TEXT_ID) id = id * 10 + (p[pos] - '0');
+        pos++;
+    }
+    src->pos = pos;
+    return (long long)id;
+}
+
+int ref_source_open_trace(ref_source_t *src, const char *path, int num_pages) {
+    memset(src, 0, sizeof(*src));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open failed for the trace");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty or unreadable trace\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap failed for the trace");
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    src->map = (const unsigned char *)map;
+    src->map_size = st.st_size;
+    src->map_len = st.st_size;
+    size_t sniff = src->map_len < SNIFF_BYTES ? src->map_len : SNIFF_BYTES;
+    src->kind = is_text(src->map, sniff) ? SOURCE_TRACE_TEXT : SOURCE_TRACE_BIN;
+    if (src->kind == SOURCE_TRACE_BIN) src->map_len -= src->map_len % sizeof(unsigned);
+
+    if (num_pages == 0) {
+        // one pass for the largest id
+        unsigned long long max_id = 0;
+        if (src->kind == SOURCE_TRACE_BIN) {
+            const unsigned *ids = (const unsigned *)src->map;
+            size_t n = src->map_len / sizeof(unsigned);
+            for (size_t i = 0; i < n; i++) {
+                if (ids[i] > max_id) max_id = ids[i];
+            }
+        } else {
+            long long id;
+            while ((id = next_text_id(src, 0)) >= 0) {
+                if ((unsigned long long)id > max_id) max_id = id;
+            }
+            src->pos = 0;
+        }
+        if (max_id >= MAX_TEXT_ID) {
+            fprintf(stderr, "%s: page id too large, give the number of pages\n", path);
+            ref_source_close(src);
+            return -1;
+        }
+        num_pages = (int)max_id + 1;
+    }
+    src->num_pages = num_pages;
+    return 0;
+}
+
+/*
+ * Alias table for zipf (Vose): every page gets a bucket with a cut-off
+ * probability and an alias, so a sample costs one random bucket and one
+ * coin flip instead of a search over the cumulative distribution.
+ */
+static int zipf_table(ref_source_t *src, double alpha) {
+    int n = src->num_pages;
+    src->zipf_prob = (double *)malloc(n * sizeof(double));
+    src->zipf_alias = (int *)malloc(n * sizeof(int));
+    int *small = (int *)malloc(n * sizeof(int));
+    int *large = (int *)malloc(n * sizeof(int));
+    if (src->zipf_prob == NULL || src->zipf_alias == NULL || small == NULL || large == NULL) {
+        perror("malloc failed for the zipf table");
+        free(small);
+        free(large);
+        return -1;
+    }
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += 1.0 / pow(i + 1, alpha);
+    }
+    int ns = 0, nl = 0;
+    for (int i = 0; i < n; i++) {
+        src->zipf_prob[i] = n / pow(i + 1, alpha) / sum;   // scaled so the average is 1
+        src->zipf_alias[i] = i;
+        if (src->zipf_prob[i] < 1.0) small[ns++] = i;
+        else large[nl++] = i;
+    }
+    while (ns > 0 && nl > 0) {
+        int s = small[--ns], l = large[nl - 1];
+        src->zipf_alias[s] = l;
+        src->zipf_prob[l] -= 1.0 - src->zipf_prob[s];
+        if (src->zipf_prob[l] < 1.0) {
+            nl--;
+            small[ns++] = l;
+        }
+    }
+    // leftovers only differ from 1 by rounding
+    while (nl > 0) src->zipf_prob[large[--nl]] = 1.0;
+    while (ns > 0) src->zipf_prob[small[--ns]] = 1.0;
+    free(small);
+    free(large);
+    return 0;
+}
+
+int ref_source_open_workload(ref_source_t *src, const char *spec, int num_pages, long length,
+                             unsigned long long seed) {
+    memset(src, 0, sizeof(*src));
+    src->num_pages = num_pages;
+    src->length = length;
+    src->seed = seed ? seed : 1;
+    src->rng = src->seed;
+
+    const char *param = strchr(spec, ':');
+    size_t name_len = param ? (size_t)(param - spec) : strlen(spec);
+    if (param) param++;
+
+    if (strncmp(spec, "uniform", name_len) == 0 && name_len == 7) {
+        src->kind = SOURCE_UNIFORM;
+    } else if (strncmp(spec, "zipf", name_len) == 0 && name_len == 4) {
+        src->kind = SOURCE_ZIPF;
+        if (zipf_table(src, param ? atof(param) : 0.99) != 0) return -1;
+    } else if (strncmp(spec, "scan", name_len) == 0 && name_len == 4) {
+        src->kind = SOURCE_SCAN;
+        src->scan_fraction = param ? atof(param) : 0.3;
+        if (zipf_table(src, 0.99) != 0) return -1;
+    } else if (strncmp(spec, "loop", name_len) == 0 && name_len == 4) {
+        src->kind = SOURCE_LOOP;
+        src->loop_len = param ? atoi(param) : num_pages;
+        if (src->loop_len <= 0 || src->loop_len > num_pages) {
+            fprintf(stderr, "loop length must be between 1 and the number of pages\n");
+            return -1;
+        }
+    } else {
+        fprintf(stderr, "Unknown workload %s\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+void ref_source_close(ref_source_t *src) {
+    if (src->map) munmap((void *)src->map, src->map_size);
+    free(src->zipf_prob);
+    free(src->zipf_alias);
+    memset(src, 0, sizeof(*src));
+}
+
+void ref_source_rewind(ref_source_t *src) {
+    src->pos = 0;
+    src->produced = 0;
+    src->scan_pos = 0;
+    src->rng = src->seed;
+}
+
+static inline unsigned long long next_random(ref_source_t *src) {
+    // xorshift64*
+    src->rng ^= src->rng >> 12;
+    src->rng ^= src->rng << 25;
+    src->rng ^= src->rng >> 27;
+    return src->rng * 2685821657736338717ULL;
+}
+
+static inline double next_unit(ref_source_t *src) {
+    return (next_random(src) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline int zipf_sample(ref_source_t *src) {
+    unsigned long long r = next_random(src);
+    int bucket = (int)((r >> 32) * (unsigned long long)src->num_pages >> 32);
+    double coin = (r & 0xffffffffULL) * (1.0 / 4294967296.0);
+    return coin < src->zipf_prob[bucket] ? bucket : src->zipf_alias[bucket];
+}
+
+long ref_source_next(ref_source_t *src, int *buf, long max) {
+    long n = 0;
+    int pages = src->num_pages;
+
+    if (src->kind == SOURCE_TRACE_BIN) {
+        const unsigned *ids = (const unsigned *)(src->map + src->pos);
+        size_t left = (src->map_len - src->pos) / sizeof(unsigned);
+        n = (long)left < max ? (long)left : max;
+        for (long i = 0; i < n; i++) {
+            unsigned id = ids[i];
+            buf[i] = id < (unsigned)pages ? (int)id : (int)(id % pages);
+        }
+        src->pos += n * sizeof(unsigned);
+        return n;
+    }
+    if (src->kind == SOURCE_TRACE_TEXT) {
+        long long id;
+        while (n < max && (id = next_text_id(src, pages)) >= 0) {
+            buf[n++] = (int)id;
+        }
+        return n;
+    }
+
+    n = src->length - src->produced < max ? src->length - src->produced : max;
+    switch (src->kind) {
+    case SOURCE_UNIFORM:
+        for (long i = 0; i < n; i++) buf[i] = (int)((next_random(src) >> 11) % pages);
+        break;
+    case SOURCE_ZIPF:
+        for (long i = 0; i < n; i++) buf[i] = zipf_sample(src);
+        break;
+    case SOURCE_SCAN:
+        for (long i = 0; i < n; i++) {
+            if (next_unit(src) < src->scan_fraction) buf[i] = (int)(src->scan_pos++ % pages);
+            else buf[i] = zipf_sample(src);
+        }
+        break;
+    case SOURCE_LOOP:
+        for (long i = 0; i < n; i++) buf[i] = (int)((src->produced + i) % src->loop_len);
+        break;
+    }
+    src->produced += n;
+    return n;
+}
@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+
+/*
+ * Sources of page references for the policy replay, handed out in chunks so a
+ * run never holds the whole reference stream in memory.
+ *
+ * A trace file is mapped with mmap and read front to back. It is either binary
+ * (native 32-bit unsigned page ids) or text (decimal ids separated by any
+ * whitespace); the format is guessed from the first bytes. Ids at or above the
+ * number of pages are folded modulo it.
+ *
+ * The synthetic workloads generate `length` references from a fixed seed, so
+ * every policy sees the same stream after ref_source_rewind():
+ *   uniform      every page equally likely
+ *   zipf[:a]     page i with probability proportional to 1 / (i + 1)^a (a = 0.99)
+ *   scan[:f]     zipf (a = 0.99) with a fraction f (default 0.3) of the
+ *                references taken by a sequential scan over all pages
+ *   loop[:n]     cycles over the first n pages (default: all)
+ */
+
+enum { SOURCE_TRACE_BIN, SOURCE_TRACE_TEXT, SOURCE_UNIFORM, SOURCE_ZIPF, SOURCE_SCAN, SOURCE_LOOP };
+
+typedef struct {
+    int kind;
+    int num_pages;
+    // trace files
+    const unsigned char *map;
+    size_t map_size;
+    size_t map_len;     // map_size cut to whole ids for binary traces
+    size_t pos;
+    // generators
+    long length;
+    long produced;
+    unsigned long long seed;
+    unsigned long long rng;
+    double *zipf_prob;  // alias table
+    int *zipf_alias;
+    double scan_fraction;
+    long scan_pos;
+    int loop_len;
+} ref_source_t;
+
+/* maps the file; num_pages 0 means one past the largest id in it (one extra pass) */
+int ref_source_open_trace(ref_source_t *src, const char *path, int num_pages);
+/* spec is one of the workloads above */
+int ref_source_open_workload(ref_source_t *src, const char *spec, int num_pages, long length,
+                             unsigned long long seed);
+void ref_source_close(ref_source_t *src);
+
+/* back to the first reference */
+void ref_source_rewind(ref_source_t *src);
+/* fills up to max references into buf, returns how many (0 at the end) */
+long ref_source_next(ref_source_t *src, int *buf, long max);
+
+#endif
@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include "placement.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* node of every CPU id, read from /sys/devices/system/node/node<N>/cpulist */
+static void read_node_map(int *node_of_cpu, int max_cpus, int *num_nodes) {
+    *num_nodes = 1;
+    for (int node = 0; node < 4096; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+            if (node > 0 && node >= *num_nodes + 64) break; // nodes may be sparse, stop after a long gap
+            continue;
+        }
+
+        char list[4096];
+        if (fgets(list, sizeof(list), f) != NULL) {
+            // ranges like "0-3,8-11"
+            char *save = NULL;
+            for (char *tok = strtok_r(list, ",\n", &save); tok != NULL; tok = strtok_r(NULL, ",\n", &save)) {
+                int lo, hi;
+                int n = sscanf(tok, "%d-%d", &lo, &hi);
+                if (n < 1) continue;
+                if (n == 1) hi = lo;
+                for (int c = lo; c <= hi && c < max_cpus; c++) node_of_cpu[c] = node;
+            }
+        }
+        fclose(f);
+        if (node + 1 > *num_nodes) *num_nodes = node + 1;
+    }
+}
+
+int topology_load(topology_t *topo) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        perror("sched_getaffinity failed");
+        return -1;
+    }
+
+    int *node_of_cpu = (int *)calloc(CPU_SETSIZE, sizeof(int)); // defaults to node 0
+    topo->num_cpus = CPU_COUNT(&allowed);
+    topo->cpus = (int *)malloc(topo->num_cpus * sizeof(int));
+    topo->cpu_node = (int *)malloc(topo->num_cpus * sizeof(int));
+    if (node_of_cpu == NULL || topo->cpus == NULL || topo->cpu_node == NULL) {
+        perror("malloc failed for topology");
+        free(node_of_cpu);
+        free(topo->cpus);
+        free(topo->cpu_node);
+        return -1;
+    }
+    read_node_map(node_of_cpu, CPU_SETSIZE, &topo->num_nodes);
+
+    // list allowed CPUs node by node so contiguous workers share a node
+    int k = 0;
+    for (int node = 0; node < topo->num_nodes; node++) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed) && node_of_cpu[c] == node) {
+                topo->cpus[k] = c;
+                topo->cpu_node[k] = node;
+                k++;
+            }
+        }
+    }
+    free(node_of_cpu);
+    return 0;
+}
+
+void topology_free(topology_t *topo) {
+    free(topo->cpus);
+    free(topo->cpu_node);
+}
+
+int placement_node_of(const topology_t *topo, int cpu) {
+    for (int i = 0; i < topo->num_cpus; i++) {
+        if (topo->cpus[i] == cpu) return topo->cpu_node[i];
+    }
+    return 0;
+}
+
+int placement_cpu(const topology_t *topo, enum placement_mode mode, int id, int num_workers) {
+    if (mode == PLACE_NONE || topo->num_cpus == 0) {
+        return -1;
+    }
+    if (mode == PLACE_PIN) {
+        return topo->cpus[id % topo->num_cpus];
+    }
+
+    // PLACE_NUMA: nodes that actually have allowed CPUs get an equal share of
+    // workers, in id order; inside a node workers go round-robin over its CPUs
+    int *node_first = (int *)malloc((topo->num_nodes + 1) * sizeof(int));
+    int used = 0;
+    for (int i = 0; i < topo->num_cpus; i++) {
+        if (i == 0 || topo->cpu_node[i] != topo->cpu_node[i - 1]) node_first[used++] = i;
+    }
+    node_first[used] = topo->num_cpus;
+
+    int group = (int)((long)id * used / num_workers);
+    int first_in_group = (int)(((long)group * num_workers + used - 1) / used); // first id mapped to this group
+    int span = node_first[group + 1] - node_first[group];
+    int cpu = topo->cpus[node_first[group] + (id - first_in_group) % span];
+    free(node_first);
+    return cpu;
+}
+
+void placement_apply(const topology_t *topo, int cpu, worker_stat_t *stat) {
+    stat->cpu = cpu;
+    stat->node = -1;
+    if (cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "could not pin worker to cpu %d\n", cpu);
+        stat->cpu = -1;
+        return;
+    }
+    stat->node = placement_node_of(topo, cpu);
+}
+
+void placement_report(const topology_t *topo, const worker_stat_t *stats, int num_workers) {
+    for (int node = 0; node < topo->num_nodes; node++) {
+        size_t bytes = 0;
+        double secs = 0.0;
+        int workers = 0;
+        for (int i = 0; i < num_workers; i++) {
+            if (stats[i].node != node) continue;
+            bytes += stats[i].bytes;
+            if (stats[i].secs > secs) secs = stats[i].secs;
+            workers++;
+        }
+        if (workers == 0) continue;
+        printf("Node %d: %d workers, %.2f MB in %.5f s, bandwidth %.2f GB/s\n",
+               node, workers, bytes / 1e6, secs, secs > 0 ? bytes / secs / 1e9 : 0.0);
+    }
+}
+
+const char *placement_name(enum placement_mode mode) {
+    switch (mode) {
+    case PLACE_PIN: return "pinned";
+    case PLACE_NUMA: return "numa";
+    default: return "unpinned";
+    }
+}
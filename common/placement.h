@@ -0,0 +1,53 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+/*
+ * CPU/NUMA placement for the threaded reducers. Workers are laid out so that
+ * neighbouring worker ids (and therefore neighbouring slices of the array) sit
+ * on the same node; if each worker also first-touches its own slice, the pages
+ * end up in that node's memory and the reduction never crosses the interconnect.
+ */
+
+enum placement_mode {
+    PLACE_NONE,  // leave scheduling to the kernel
+    PLACE_PIN,   // --pin: worker i on the i-th allowed CPU
+    PLACE_NUMA   // --numa: workers split into contiguous groups, one group per node
+};
+
+typedef struct {
+    int num_cpus;   // CPUs in our affinity mask
+    int *cpus;      // their ids, grouped by node
+    int *cpu_node;  // node of cpus[i]
+    int num_nodes;
+} topology_t;
+
+/* per-worker measurements, padded so workers never share a line */
+typedef struct {
+    _Alignas(CACHE_LINE) int cpu;
+    int node;
+    size_t bytes;   // bytes streamed by this worker
+    double secs;    // time spent streaming them
+} worker_stat_t;
+
+int topology_load(topology_t *topo);
+void topology_free(topology_t *topo);
+
+/* CPU for worker id out of num_workers, or -1 in PLACE_NONE mode */
+int placement_cpu(const topology_t *topo, enum placement_mode mode, int id, int num_workers);
+int placement_node_of(const topology_t *topo, int cpu);
+
+/* pins the calling thread; fills stat->cpu/node (cpu -1 leaves the thread unpinned) */
+void placement_apply(const topology_t *topo, int cpu, worker_stat_t *stat);
+
+/* prints streamed GB/s per node; a node's time is its slowest worker's */
+void placement_report(const topology_t *topo, const worker_stat_t *stats, int num_workers);
+
+const char *placement_name(enum placement_mode mode);
+
+#endif
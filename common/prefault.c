@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+#include "prefault.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23 // Linux 5.14
+#endif
+
+typedef struct {
+    char *start;
+    size_t len;
+    size_t step;
+    int mode;
+    int populate_failed;
+    int started;
+    pthread_t thread;
+} prefault_slice_t;
+
+static void touch(char *start, size_t len, size_t step) {
+    volatile char *p = start;
+    for (size_t off = 0; off < len; off += step) {
+        p[off] = 0;
+    }
+}
+
+static void *prefault_worker(void *arg) {
+    prefault_slice_t *s = (prefault_slice_t *)arg;
+    if (s->mode == PREFAULT_ZERO) {
+        memset(s->start, 0, s->len);
+    } else if (s->mode == PREFAULT_POPULATE) {
+        if (madvise(s->start, s->len, MADV_POPULATE_WRITE) != 0) {
+            s->populate_failed = errno;
+            touch(s->start, s->len, s->step);
+        }
+    } else {
+        touch(s->start, s->len, s->step);
+    }
+    return NULL;
+}
+
+int prefault(void *addr, size_t len, size_t step, int num_threads, enum prefault_mode mode,
+             prefault_stats_t *stats) {
+    size_t steps = (len + step - 1) / step;
+    if (num_threads < 1) num_threads = 1;
+    if ((size_t)num_threads > steps) num_threads = steps > 0 ? (int)steps : 1;
+
+    prefault_slice_t *slices = (prefault_slice_t *)calloc(num_threads, sizeof(prefault_slice_t));
+    if (slices == NULL) {
+        perror("calloc failed for prefault slices");
+        return -1;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        size_t first = steps * i / num_threads;
+        size_t last = steps * (i + 1) / num_threads;
+        slices[i].start = (char *)addr + first * step;
+        slices[i].len = last * step < len ? (last - first) * step : len - first * step;
+        slices[i].step = step;
+        slices[i].mode = mode;
+    }
+
+    struct rusage before, after;
+    struct timespec start, end;
+    getrusage(RUSAGE_SELF, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // the calling thread takes slice 0
+    for (int i = 1; i < num_threads; i++) {
+        slices[i].started = pthread_create(&slices[i].thread, NULL, prefault_worker, &slices[i]) == 0;
+        if (!slices[i].started) prefault_worker(&slices[i]);
+    }
+    prefault_worker(&slices[0]);
+    for (int i = 1; i < num_threads; i++) {
+        if (slices[i].started) pthread_join(slices[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &after);
+
+    int fell_back = 0;
+    for (int i = 0; i < num_threads; i++) {
+        fell_back |= slices[i].populate_failed != 0;
+    }
+    if (stats) {
+        stats->threads = num_threads;
+        stats->mode = fell_back ? PREFAULT_TOUCH : mode;
+        stats->bytes = len;
+        stats->secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        stats->minor_faults = after.ru_minflt - before.ru_minflt;
+        stats->major_faults = after.ru_majflt - before.ru_majflt;
+    }
+    free(slices);
+    return 0;
+}
+
+double prefault_gb_per_s(const prefault_stats_t *stats) {
+    return stats->secs > 0 ? stats->bytes / stats->secs / 1e9 : 0.0;
+}
+
+double prefault_faults_per_s(const prefault_stats_t *stats) {
+    return stats->secs > 0 ? stats->minor_faults / stats->secs : 0.0;
+}
+
+const char *prefault_mode_name(int mode) {
+    switch (mode) {
+    case PREFAULT_ZERO: return "zero";
+    case PREFAULT_POPULATE: return "populate";
+    default: return "touch";
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef PREFAULT_H
+#define PREFAULT_H
+
+#include <stddef.h>
+
+/*
+ * Parallel first touch of a freshly mapped range. The range is cut into one
+ * contiguous slice per thread (on step boundaries, step being the page size
+ * backing the range) and every thread faults in its own slice, so page faults
+ * are taken on all cores at once instead of one after the other.
+ */
+
+enum prefault_mode {
+    PREFAULT_TOUCH,     // write one byte of zero per step
+    PREFAULT_ZERO,      // memset the slice, for memory that is not zero yet (malloc)
+    PREFAULT_POPULATE   // madvise(MADV_POPULATE_WRITE) on the slice, falls back to TOUCH where unsupported
+};
+
+typedef struct {
+    int threads;
+    int mode;           // the mode that actually ran (POPULATE may fall back to TOUCH)
+    size_t bytes;
+    double secs;
+    long minor_faults;  // for the whole process over the call, from getrusage
+    long major_faults;
+} prefault_stats_t;
+
+/* 0 on success; stats may be NULL */
+int prefault(void *addr, size_t len, size_t step, int num_threads, enum prefault_mode mode,
+             prefault_stats_t *stats);
+
+/* GB/s and faults/s of a finished call */
+double prefault_gb_per_s(const prefault_stats_t *stats);
+double prefault_faults_per_s(const prefault_stats_t *stats);
+
+const char *prefault_mode_name(int mode);
+
+#endif
@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include "sum_kernel.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LANES 16 // element i of a block always lands in accumulator lane i % LANES
+
+typedef double (*block_f64_fn)(const double *a, size_t len, int comp);
+typedef double (*block_f32_fn)(const float *a, size_t len, int comp);
+
+static double scalar_block_f64(const double *a, size_t len, int comp);
+static double scalar_block_f32(const float *a, size_t len, int comp);
+
+static enum sum_mode kernel_mode = SUM_PLAIN;
+static const char *kernel_name = "scalar";
+static block_f64_fn block_f64 = scalar_block_f64;
+static block_f32_fn block_f32 = scalar_block_f32;
+
+static inline void neumaier_add(double *sum, double *comp, double x) {
+    double t = *sum + x;
+    if (fabs(*sum) >= fabs(x)) *comp += (*sum - t) + x;
+    else *comp += (x - t) + *sum;
+    *sum = t;
+}
+
+/*
+ * Adds the last len % LANES elements of a block into their lanes and folds the
+ * lanes. Every ISA variant ends here with the same lane contents, which is what
+ * keeps AVX-512, AVX2 and scalar results bit-identical.
+ */
+static double finish_block(double *s, double *c, const double *tail, size_t tail_len, int comp) {
+    for (size_t j = 0; j < tail_len; j++) {
+        if (comp) neumaier_add(&s[j], &c[j], tail[j]);
+        else s[j] += tail[j];
+    }
+
+    if (!comp) {
+        for (int width = LANES / 2; width > 0; width /= 2) { // fixed pairwise tree
+            for (int l = 0; l < width; l++) {
+                s[l] += s[l + width];
+            }
+        }
+        return s[0];
+    }
+
+    double sum = s[0], err = c[0];
+    for (int l = 1; l < LANES; l++) {
+        neumaier_add(&sum, &err, s[l]);
+        err += c[l];
+    }
+    return sum + err;
+}
+
+/* ---------------- scalar fallback ---------------- */
+
+static double scalar_block_f64(const double *a, size_t len, int comp) {
+    double s[LANES] = {0}, c[LANES] = {0};
+    size_t vec_end = len & ~(size_t)(LANES - 1);
+
+    for (size_t i = 0; i < vec_end; i += LANES) {
+        for (int l = 0; l < LANES; l++) {
+            if (comp) neumaier_add(&s[l], &c[l], a[i + l]);
+            else s[l] += a[i + l];
+        }
+    }
+    return finish_block(s, c, a + vec_end, len - vec_end, comp);
+}
+
+static double scalar_block_f32(const float *a, size_t len, int comp) {
+    double s[LANES] = {0}, c[LANES] = {0};
+    size_t vec_end = len & ~(size_t)(LANES - 1);
+
+    for (size_t i = 0; i < vec_end; i += LANES) {
+        for (int l = 0; l < LANES; l++) {
+            if (comp) neumaier_add(&s[l], &c[l], (double)a[i + l]);
+            else s[l] += (double)a[i + l];
+        }
+    }
+
+    double tail[LANES];
+    for (size_t j = 0; j < len - vec_end; j++) tail[j] = a[vec_end + j];
+    return finish_block(s, c, tail, len - vec_end, comp);
+}
+
+/* ---------------- AVX2: 4 x 4 doubles ---------------- */
+
+__attribute__((target("avx2")))
+static inline void neumaier_avx2(__m256d *s, __m256d *c, __m256d x) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d t = _mm256_add_pd(*s, x);
+    __m256d s_big = _mm256_cmp_pd(_mm256_andnot_pd(sign, *s), _mm256_andnot_pd(sign, x), _CMP_GE_OQ);
+    __m256d big = _mm256_blendv_pd(x, *s, s_big);
+    __m256d small = _mm256_blendv_pd(*s, x, s_big);
+    *c = _mm256_add_pd(*c, _mm256_add_pd(_mm256_sub_pd(big, t), small));
+    *s = t;
+}
+
+__attribute__((target("avx2")))
+static double avx2_block_f64(const double *a, size_t len, int comp) {
+    __m256d s[4], c[4];
+    for (int k = 0; k < 4; k++) s[k] = c[k] = _mm256_setzero_pd();
+    size_t vec_end = len & ~(size_t)(LANES - 1);
+
+    if (comp) {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 4; k++) neumaier_avx2(&s[k], &c[k], _mm256_loadu_pd(a + i + 4 * k));
+    } else {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 4; k++) s[k] = _mm256_add_pd(s[k], _mm256_loadu_pd(a + i + 4 * k));
+    }
+
+    double ls[LANES], lc[LANES];
+    for (int k = 0; k < 4; k++) {
+        _mm256_storeu_pd(ls + 4 * k, s[k]);
+        _mm256_storeu_pd(lc + 4 * k, c[k]);
+    }
+    return finish_block(ls, lc, a + vec_end, len - vec_end, comp);
+}
+
+__attribute__((target("avx2")))
+static double avx2_block_f32(const float *a, size_t len, int comp) {
+    __m256d s[4], c[4];
+    for (int k = 0; k < 4; k++) s[k] = c[k] = _mm256_setzero_pd();
+    size_t vec_end = len & ~(size_t)(LANES - 1);
+
+    if (comp) {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 4; k++)
+                neumaier_avx2(&s[k], &c[k], _mm256_cvtps_pd(_mm_loadu_ps(a + i + 4 * k)));
+    } else {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 4; k++)
+                s[k] = _mm256_add_pd(s[k], _mm256_cvtps_pd(_mm_loadu_ps(a + i + 4 * k)));
+    }
+
+    double ls[LANES], lc[LANES], tail[LANES];
+    for (int k = 0; k < 4; k++) {
+        _mm256_storeu_pd(ls + 4 * k, s[k]);
+        _mm256_storeu_pd(lc + 4 * k, c[k]);
+    }
+    for (size_t j = 0; j < len - vec_end; j++) tail[j] = a[vec_end + j];
+    return finish_block(ls, lc, tail, len - vec_end, comp);
+}
+
+/* ---------------- AVX-512: 2 x 8 doubles ---------------- */
+
+__attribute__((target("avx512f")))
+static inline void neumaier_avx512(__m512d *s, __m512d *c, __m512d x) {
+    __m512d t = _mm512_add_pd(*s, x);
+    __mmask8 s_big = _mm512_cmp_pd_mask(_mm512_abs_pd(*s), _mm512_abs_pd(x), _CMP_GE_OQ);
+    __m512d big = _mm512_mask_blend_pd(s_big, x, *s);
+    __m512d small = _mm512_mask_blend_pd(s_big, *s, x);
+    *c = _mm512_add_pd(*c, _mm512_add_pd(_mm512_sub_pd(big, t), small));
+    *s = t;
+}
+
+__attribute__((target("avx512f")))
+static double avx512_block_f64(const double *a, size_t len, int comp) {
+    __m512d s[2], c[2];
+    for (int k = 0; k < 2; k++) s[k] = c[k] = _mm512_setzero_pd();
+    size_t vec_end = len & ~(size_t)(LANES - 1);
+
+    if (comp) {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 2; k++) neumaier_avx512(&s[k], &c[k], _mm512_loadu_pd(a + i + 8 * k));
+    } else {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 2; k++) s[k] = _mm512_add_pd(s[k], _mm512_loadu_pd(a + i + 8 * k));
+    }
+
+    double ls[LANES], lc[LANES];
+    for (int k = 0; k < 2; k++) {
+        _mm512_storeu_pd(ls + 8 * k, s[k]);
+        _mm512_storeu_pd(lc + 8 * k, c[k]);
+    }
+    return finish_block(ls, lc, a + vec_end, len - vec_end, comp);
+}
+
+__attribute__((target("avx512f")))
+static double avx512_block_f32(const float *a, size_t len, int comp) {
+    __m512d s[2], c[2];
+    for (int k = 0; k < 2; k++) s[k] = c[k] = _mm512_setzero_pd();
+    size_t vec_end = len & ~(size_t)(LANES - 1);
+
+    if (comp) {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 2; k++)
+                neumaier_avx512(&s[k], &c[k], _mm512_cvtps_pd(_mm256_loadu_ps(a + i + 8 * k)));
+    } else {
+        for (size_t i = 0; i < vec_end; i += LANES)
+            for (int k = 0; k < 2; k++)
+                s[k] = _mm512_add_pd(s[k], _mm512_cvtps_pd(_mm256_loadu_ps(a + i + 8 * k)));
+    }
+
+    double ls[LANES], lc[LANES], tail[LANES];
+    for (int k = 0; k < 2; k++) {
+        _mm512_storeu_pd(ls + 8 * k, s[k]);
+        _mm512_storeu_pd(lc + 8 * k, c[k]);
+    }
+    for (size_t j = 0; j < len - vec_end; j++) tail[j] = a[vec_end + j];
+    return finish_block(ls, lc, tail, len - vec_end, comp);
+}
+
+/* ---------------- dispatch ---------------- */
+
+void sum_kernel_init(enum sum_mode mode) {
+    kernel_mode = mode;
+
+    int level = 2; // 2 = AVX-512, 1 = AVX2, 0 = scalar
+    const char *force = getenv("SUM_ISA");
+    if (force != NULL) {
+        if (strcmp(force, "scalar") == 0) level = 0;
+        else if (strcmp(force, "avx2") == 0) level = 1;
+        else if (strcmp(force, "avx512") != 0) fprintf(stderr, "SUM_ISA=%s not recognised, ignoring\n", force);
+    }
+
+    __builtin_cpu_init();
+    if (level >= 2 && __builtin_cpu_supports("avx512f")) {
+        kernel_name = "avx512";
+        block_f64 = avx512_block_f64;
+        block_f32 = avx512_block_f32;
+    } else if (level >= 1 && __builtin_cpu_supports("avx2")) {
+        kernel_name = "avx2";
+        block_f64 = avx2_block_f64;
+        block_f32 = avx2_block_f32;
+    } else {
+        kernel_name = "scalar";
+        block_f64 = scalar_block_f64;
+        block_f32 = scalar_block_f32;
+    }
+}
+
+const char *sum_kernel_name(void) {
+    return kernel_name;
+}
+
+void sum_blocks_f64(const double *a, size_t n, double *out) {
+    int comp = kernel_mode == SUM_NEUMAIER;
+    for (size_t b = 0; b < sum_num_blocks(n); b++) {
+        size_t start = b * SUM_BLOCK;
+        size_t len = n - start < SUM_BLOCK ? n - start : SUM_BLOCK;
+        out[b] = block_f64(a + start, len, comp);
+    }
+}
+
+void sum_blocks_f32(const float *a, size_t n, double *out) {
+    int comp = kernel_mode == SUM_NEUMAIER;
+    for (size_t b = 0; b < sum_num_blocks(n); b++) {
+        size_t start = b * SUM_BLOCK;
+        size_t len = n - start < SUM_BLOCK ? n - start : SUM_BLOCK;
+        out[b] = block_f32(a + start, len, comp);
+    }
+}
+
+double sum_merge_blocks(const double *blocks, size_t nblocks) {
+    double sum = 0.0, err = 0.0;
+    for (size_t b = 0; b < nblocks; b++) {
+        if (kernel_mode == SUM_NEUMAIER) neumaier_add(&sum, &err, blocks[b]);
+        else sum += blocks[b];
+    }
+    return sum + err;
+}
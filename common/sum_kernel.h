@@ -0,0 +1,39 @@
+#ifndef SUM_KERNEL_H
+#define SUM_KERNEL_H
+
+#include <stddef.h>
+
+/*
+ * Summation kernel shared by the process reducer (assignment1/question_8.c) and
+ * the thread reducer (assignment_2/question6/question_6.c).
+ *
+ * The input is cut into fixed blocks of SUM_BLOCK elements counted from the start
+ * of the whole array. Every block is summed the same way no matter which worker
+ * gets it or which instruction set is used (16 interleaved accumulators folded in a
+ * fixed order), and block sums are merged in index order. As long as workers split
+ * the array on block boundaries, the total is bit-identical for any worker count.
+ */
+
+#define SUM_BLOCK 4096
+
+enum sum_mode {
+    SUM_PLAIN,     // independent accumulators only
+    SUM_NEUMAIER   // accumulators carry Kahan/Neumaier compensation terms
+};
+
+/* picks AVX-512, AVX2 or scalar code via CPUID; SUM_ISA=scalar|avx2|avx512 overrides */
+void sum_kernel_init(enum sum_mode mode);
+const char *sum_kernel_name(void);
+
+static inline size_t sum_num_blocks(size_t n) {
+    return (n + SUM_BLOCK - 1) / SUM_BLOCK;
+}
+
+/* sums a[0..n) into out[0..sum_num_blocks(n)), one value per block; a must start on a block boundary */
+void sum_blocks_f64(const double *a, size_t n, double *out);
+void sum_blocks_f32(const float *a, size_t n, double *out);
+
+/* folds block sums left to right, compensated in SUM_NEUMAIER mode */
+double sum_merge_blocks(const double *blocks, size_t nblocks);
+
+#endif
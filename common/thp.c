@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+#include "thp.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+int thp_enabled(void) {
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f == NULL) return 0;
+    char line[128] = "";
+    if (fgets(line, sizeof(line), f) == NULL) line[0] = '\0';
+    fclose(f);
+    return line[0] != '\0' && strstr(line, "[never]") == NULL;
+}
+
+void *thp_map(size_t size, size_t *len) {
+    *len = (size + THP_SIZE - 1) & ~(THP_SIZE - 1);
+    // over-map by 2 MB and trim, so the range starts on a huge page boundary
+    char *p = (char *)mmap(NULL, *len + THP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    char *aligned = (char *)(((unsigned long)p + THP_SIZE - 1) & ~(THP_SIZE - 1));
+    if (aligned > p) munmap(p, aligned - p);
+    size_t tail = (p + *len + THP_SIZE) - (aligned + *len);
+    if (tail) munmap(aligned + *len, tail);
+    if (madvise(aligned, *len, MADV_HUGEPAGE) != 0) {
+        int err = errno;
+        munmap(aligned, *len);
+        errno = err;
+        return NULL;
+    }
+    return aligned;
+}
+
+long anon_huge_kb(const void *addr) {
+    FILE *f = fopen(addr ? "/proc/self/smaps" : "/proc/self/smaps_rollup", "r");
+    if (f == NULL) return -1;
+    char line[256];
+    long kb = -1;
+    int inside = addr == NULL;    // the rollup is a single entry covering everything
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        char perms[8];
+        // each mapping starts with a "start-end perms ..." line, its counters follow
+        if (addr && sscanf(line, "%lx-%lx %7s", &start, &end, perms) == 3) {
+            if (inside) break;
+            inside = (unsigned long)addr >= start && (unsigned long)addr < end;
+            continue;
+        }
+        if (inside && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
@@ -0,0 +1,31 @@
+#ifndef THP_H
+#define THP_H
+
+#include <stddef.h>
+
+#define THP_SIZE (2UL << 20)
+
+/*
+ * Transparent huge pages for the fault benchmarks. THP is best effort: a
+ * range madvised for huge pages still gets base pages wherever the kernel
+ * finds no free 2 MB block, so callers should check how much of it ended up
+ * huge with anon_huge_kb().
+ */
+
+/* 0 if THP is switched off altogether (enabled set to never) */
+int thp_enabled(void);
+
+/*
+ * Anonymous mapping of size bytes rounded up to 2 MB, starting on a 2 MB
+ * boundary and madvised MADV_HUGEPAGE. The mapped length goes to *len.
+ * NULL with errno set on failure.
+ */
+void *thp_map(size_t size, size_t *len);
+
+/*
+ * AnonHugePages in kB of the mapping containing addr, or of the whole process
+ * when addr is NULL; -1 if the kernel does not say.
+ */
+long anon_huge_kb(const void *addr);
+
+#endif
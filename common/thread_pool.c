@@ -0,0 +1,99 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct pool_worker {
+    thread_pool_t *pool;
+    int id;
+    pthread_t thread;
+};
+
+static void futex_wait(void *addr, int expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(void *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static void *pool_worker_func(void *arg) {
+    struct pool_worker *self = (struct pool_worker *)arg;
+    thread_pool_t *pool = self->pool;
+    unsigned seen = 0;
+
+    for (;;) {
+        unsigned gen;
+        // sleep until the main thread publishes a new generation
+        while ((gen = __atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE)) == seen) {
+            futex_wait(&pool->generation, (int)seen);
+        }
+        seen = gen;
+
+        if (__atomic_load_n(&pool->shutdown, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        pool->job(self->id, pool->job_arg);
+
+        if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+            futex_wake(&pool->pending, 1); // last one out wakes the main thread
+        }
+    }
+    return NULL;
+}
+
+int pool_start(thread_pool_t *pool, int num_threads) {
+    pool->num_threads = num_threads;
+    pool->generation = 0;
+    pool->pending = 0;
+    pool->shutdown = 0;
+    pool->job = NULL;
+    pool->job_arg = NULL;
+
+    pool->workers = (struct pool_worker *)malloc(num_threads * sizeof(struct pool_worker));
+    if (pool->workers == NULL) {
+        perror("malloc failed for pool");
+        return -1;
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, pool_worker_func, &pool->workers[i]) != 0) {
+            perror("Failed to create thread");
+            pool->num_threads = i; // only stop the ones that exist
+            pool_stop(pool);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void pool_run(thread_pool_t *pool, pool_job_fn job, void *arg) {
+    pool->job = job;
+    pool->job_arg = arg;
+    __atomic_store_n(&pool->pending, pool->num_threads, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE); // publishes job, arg and pending
+    futex_wake(&pool->generation, INT_MAX);
+
+    int left;
+    while ((left = __atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE)) != 0) {
+        futex_wait(&pool->pending, left);
+    }
+}
+
+void pool_stop(thread_pool_t *pool) {
+    __atomic_store_n(&pool->shutdown, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+    futex_wake(&pool->generation, INT_MAX);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    free(pool->workers);
+}
@@ -0,0 +1,35 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+/*
+ * Persistent worker pool. Workers are created once and park on a futex between
+ * jobs; pool_run() hands the same job to every worker and returns when all of
+ * them are done, so repeated reductions pay a wake-up instead of pthread_create.
+ */
+
+typedef void (*pool_job_fn)(int id, void *arg);
+
+struct pool_worker;
+
+typedef struct thread_pool {
+    int num_threads;
+    struct pool_worker *workers;
+
+    pool_job_fn job;           // job of the current generation
+    void *job_arg;
+    _Alignas(CACHE_LINE) unsigned generation; // bumped to release the parked workers
+    _Alignas(CACHE_LINE) int pending;         // workers that have not finished the current job
+    int shutdown;
+} thread_pool_t;
+
+int pool_start(thread_pool_t *pool, int num_threads);
+void pool_run(thread_pool_t *pool, pool_job_fn job, void *arg);
+void pool_stop(thread_pool_t *pool);
+
+#endif
@@ -0,0 +1,135 @@
+#include "ws_sched.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int ws_init(ws_sched_t *ws, size_t num_items, size_t chunk, int num_workers) {
+    ws->num_items = num_items;
+    ws->chunk = chunk > 0 ? chunk : 1;
+    ws->num_chunks = (long)((num_items + ws->chunk - 1) / ws->chunk);
+    ws->num_workers = num_workers;
+    ws->deques = (ws_deque_t *)aligned_alloc(CACHE_LINE, num_workers * sizeof(ws_deque_t));
+    if (ws->deques == NULL) {
+        perror("malloc failed for deques");
+        return -1;
+    }
+    for (int w = 0; w < num_workers; w++) {
+        ws->deques[w].executed = 0;
+        ws->deques[w].stolen = 0;
+        ws->deques[w].rng = 2463534242u + 7919u * w;
+    }
+    ws_reset(ws);
+    return 0;
+}
+
+void ws_free(ws_sched_t *ws) {
+    free(ws->deques);
+}
+
+void ws_reset(ws_sched_t *ws) {
+    for (int w = 0; w < ws->num_workers; w++) {
+        ws->deques[w].top = ws->num_chunks * w / ws->num_workers;
+        ws->deques[w].bottom = ws->num_chunks * (w + 1) / ws->num_workers;
+    }
+}
+
+/* owner end: takes the chunk at the bottom, -1 when the deque is empty */
+static long ws_pop(ws_deque_t *d) {
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // thieves must see the smaller bottom before we read top
+    long t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if (t > b) { // already empty
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    if (t == b) { // last chunk: race the thieves for it
+        int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return won ? b : -1;
+    }
+    return b;
+}
+
+/* thief end: takes the chunk at the top, -1 when empty, -2 when another thief won */
+static long ws_steal(ws_deque_t *d) {
+    long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b) {
+        return -1;
+    }
+    if (__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return t;
+    }
+    return -2;
+}
+
+static void run_chunk(ws_sched_t *ws, int worker, long c, ws_chunk_fn fn, void *arg) {
+    size_t begin = (size_t)c * ws->chunk;
+    size_t end = begin + ws->chunk < ws->num_items ? begin + ws->chunk : ws->num_items;
+    fn(worker, begin, end, arg);
+}
+
+void ws_work(ws_sched_t *ws, int worker, ws_chunk_fn fn, void *arg) {
+    ws_deque_t *self = &ws->deques[worker];
+    long c;
+
+    while ((c = ws_pop(self)) >= 0) {
+        run_chunk(ws, worker, c, fn, arg);
+        self->executed++;
+    }
+
+    if (ws->num_workers == 1) {
+        return;
+    }
+
+    // own deque is dry: steal from random victims. Work is never added, so once
+    // a full pass finds every deque empty there is nothing left to do.
+    int misses = 0;
+    for (;;) {
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 17;
+        self->rng ^= self->rng << 5;
+        int victim = self->rng % (ws->num_workers - 1);
+        if (victim >= worker) victim++; // never ourselves
+
+        c = ws_steal(&ws->deques[victim]);
+        if (c >= 0) {
+            run_chunk(ws, worker, c, fn, arg);
+            self->executed++;
+            self->stolen++;
+            misses = 0;
+            continue;
+        }
+        if (c == -2 || ++misses < ws->num_workers) {
+            continue;
+        }
+
+        int all_empty = 1;
+        for (int v = 0; v < ws->num_workers && all_empty; v++) {
+            ws_deque_t *d = &ws->deques[v];
+            if (__atomic_load_n(&d->top, __ATOMIC_ACQUIRE) < __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE)) {
+                all_empty = 0;
+            }
+        }
+        if (all_empty) {
+            return;
+        }
+        misses = 0;
+    }
+}
+
+void ws_report(const ws_sched_t *ws) {
+    long total = 0;
+    for (int w = 0; w < ws->num_workers; w++) {
+        total += ws->deques[w].executed;
+    }
+    printf("Work stealing: %ld chunks of %zu items\n", total, ws->chunk);
+    for (int w = 0; w < ws->num_workers; w++) {
+        const ws_deque_t *d = &ws->deques[w];
+        printf("Worker %2d: %ld chunks (%.1f%%), %ld stolen\n", w, d->executed,
+               total > 0 ? 100.0 * d->executed / total : 0.0, d->stolen);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef WS_SCHED_H
+#define WS_SCHED_H
+
+#include <stddef.h>
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+/*
+ * Work-stealing scheduler over a fixed range of items (array elements).
+ *
+ * The range is cut into fixed-size chunks and every worker starts with a
+ * contiguous run of them in its own deque. A worker takes chunks from the
+ * bottom of its deque; once it runs dry it steals from the top of a randomly
+ * chosen victim's deque, so a slow or descheduled worker no longer sets the
+ * wall time. No work is created while running, so deque slots are just chunk
+ * numbers and a deque is fully described by its [top, bottom) pair.
+ */
+
+typedef void (*ws_chunk_fn)(int worker, size_t begin, size_t end, void *arg);
+
+typedef struct {
+    _Alignas(CACHE_LINE) long top;     // next chunk a thief would take
+    _Alignas(CACHE_LINE) long bottom;  // one past the owner's next chunk
+    _Alignas(CACHE_LINE) long executed; // chunks run by this worker, stolen ones included
+    long stolen;                       // chunks this worker took from someone else
+    unsigned rng;                      // victim selection state
+} ws_deque_t;
+
+typedef struct {
+    size_t num_items;
+    size_t chunk;      // items per chunk
+    long num_chunks;
+    int num_workers;
+    ws_deque_t *deques;
+} ws_sched_t;
+
+int ws_init(ws_sched_t *ws, size_t num_items, size_t chunk, int num_workers);
+void ws_free(ws_sched_t *ws);
+
+/* deals the chunks out again; call from one thread before every run */
+void ws_reset(ws_sched_t *ws);
+
+/* run by every worker; returns once no chunk is left anywhere */
+void ws_work(ws_sched_t *ws, int worker, ws_chunk_fn fn, void *arg);
+
+/* prints per-worker chunk counts, accumulated since ws_init */
+void ws_report(const ws_sched_t *ws);
+
+#endif